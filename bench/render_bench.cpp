@@ -0,0 +1,457 @@
+/******************************************************************************
+
+  Rendering benchmarks
+
+  The screens are driven on a headless terminal, so the output measured is the
+  one a real terminal would receive. Each benchmark prints one JSON object per
+  line:
+
+	{"name":"label_set_value","ops":20000,"ops_per_sec":...,"bytes":...,
+	 "bytes_per_op":...,"flushes":...,"p50_ns":...,"p99_ns":...}
+
+  flushes is the number of terminal updates: one per frame, plus one per CDK
+  widget drawn in the frames, as the draw functions of CDK call wrefresh.
+
+  Usage: render_bench [--filter text] [--ops count] [--rows rows] [--cols cols]
+
+  The exit status is 1 if a check fails: screen_cycle checks that building and
+  tearing down a screen keeps the memory flat.
+
+  The render_bench target of CMakeLists.txt builds it as C++20, so that the
+  benchmarks of the coroutines are included.
+
+******************************************************************************/
+
+#include "cdk_support.h"
+#include "curses_widgets.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <malloc.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct Options
+	{
+		std::string filter{};
+		std::size_t ops = 20000;
+		int rows = 50;
+		int cols = 160;
+	};
+
+	Options options;
+	/// Set by the benchmarks which check a property, such as the memory of
+	/// the screens staying flat. The exit status is then 1
+	bool failed = false;
+
+	/// Run op count times and print the result. op receives the number of the
+	/// operation
+	void run(const std::string & name, std::size_t count, const std::function<void(std::size_t)> & op)
+	{
+		if (!options.filter.empty() && name.find(options.filter) == std::string::npos)
+			return;
+		auto terminal = tui::CdkApp::getCdkApp()->getHeadless();
+		auto & scheduler = tui::CdkApp::getCdkApp()->getFrameScheduler();
+		auto flushes = [&scheduler]()
+		{
+			return scheduler.framesProduced() + scheduler.sourceFlushCount();
+		};
+		std::vector<std::int64_t> latencies(count);
+		auto flushesBefore = flushes();
+		auto bytesBefore = terminal->sync();
+		auto start = Clock::now();
+		for (std::size_t n = 0; n < count; ++n)
+		{
+			auto opStart = Clock::now();
+			op(n);
+			latencies[n] = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - opStart).count();
+		}
+		auto elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+		auto bytes = terminal->sync() - bytesBefore;
+		auto flushCount = flushes() - flushesBefore;
+
+		std::sort(latencies.begin(), latencies.end());
+		auto percentile = [&latencies](double p)
+		{
+			return latencies.empty() ? 0 : latencies[static_cast<std::size_t>(p * (latencies.size() - 1))];
+		};
+		std::printf("{\"name\":\"%s\",\"ops\":%zu,\"ops_per_sec\":%.1f,\"bytes\":%llu,"
+				"\"bytes_per_op\":%.1f,\"flushes\":%llu,\"p50_ns\":%lld,\"p99_ns\":%lld}\n",
+				name.c_str(), count, elapsed > 0 ? count / elapsed : 0.0,
+				static_cast<unsigned long long>(bytes), count ? double(bytes) / count : 0.0,
+				static_cast<unsigned long long>(flushCount),
+				static_cast<long long>(percentile(0.50)), static_cast<long long>(percentile(0.99)));
+		std::fflush(stdout);
+	}
+
+	/// Creation and destruction of a label, drawn once
+	void widgetConstruction(tui::CdkScreen & screen)
+	{
+		run("widget_construction", options.ops / 4, [&screen](std::size_t n)
+		{
+			tui::CdkLabel label(screen, 1, 1, "Label " + std::to_string(n), false);
+			label.invalidate();
+			screen.commit();
+		});
+	}
+
+	/// New text in a label, one frame per value
+	void labelSetValue(tui::CdkScreen & screen)
+	{
+		tui::CdkLabel label(screen, 1, 1, "Value:          ", false);
+		screen.refresh();
+		std::string text;
+		run("label_set_value", options.ops, [&](std::size_t n)
+		{
+			text = "Value: " + std::to_string(n * 7919 % 1000000);
+			label.setValue(text);
+			screen.commit();
+		});
+	}
+
+	/// Slider updated faster than the frame rate, with and without coalescing
+	void sliderSetValue(tui::CdkScreen & screen)
+	{
+		tui::CdkFSlider slider(screen, 1, 3, "", "Level", 0, 0, 100, 1);
+		screen.refresh();
+		for (bool coalescing : {false, true})
+		{
+			slider.setCoalescing(coalescing);
+			run(coalescing ? "fslider_set_value_coalesced" : "fslider_set_value", options.ops, [&](std::size_t n)
+			{
+				slider.setValue(static_cast<float>(n % 10000) / 100);
+				screen.commit();
+			});
+		}
+		slider.setCoalescing(false);
+	}
+
+	/// Redraw of a screen full of labels and entries
+	void fullRefresh(tui::CdkScreen & screen)
+	{
+		std::vector<std::unique_ptr<tui::CdkWidget>> widgets;
+		for (int row = 0; row + 3 <= screen.h(); row += 3)
+			for (int col = 0; col + 30 <= screen.w(); col += 30)
+			{
+				if ((row / 3 + col / 30) % 2 == 0)
+					widgets.emplace_back(new tui::CdkLabel(screen, col, row, "Label " + std::to_string(row * 1000 + col)));
+				else
+					widgets.emplace_back(new tui::CdkEntry(screen, col, row, "", "Entry", vMIXED, 12, 0, 12));
+			}
+		run("full_refresh", options.ops / 20, [&screen](std::size_t)
+		{
+			screen.refresh();
+		});
+		widgets.clear();
+		screen.erase();
+	}
+
+	/// Keys sent to an entry, each going through preHandler and postHandler
+	void keyDispatch(tui::CdkScreen & screen)
+	{
+		tui::CdkEntry entry(screen, 1, 1, "", "Name", vMIXED, 20, 0, 20);
+		screen.refresh();
+		run("key_dispatch", options.ops, [&](std::size_t n)
+		{
+			if (n % 20 == 0)
+				entry.clear();
+			entry.inject(static_cast<chtype>('a' + n % 26));
+			screen.commit();
+		});
+	}
+
+	/// Entry exposing the two ways of finding the widget of a key handler
+	class DispatchProbe : public tui::CdkEntry
+	{
+	public:
+		using CdkEntry::CdkEntry;
+
+		/// The widget is looked up from the CDK object, as the handlers did
+		/// before they used the clientData
+		int lookupDispatch(chtype key)
+		{
+			return static_cast<DispatchProbe *>(tui::CdkApp::getWidget(getCDKObject()))->preProcess(key);
+		}
+
+		/// The widget is the clientData given to CDK
+		int clientDataDispatch(chtype key)
+		{
+			return preHandler(vENTRY, getCDKObject(), clientData(), key);
+		}
+	};
+
+	/// Entry whose handlers are bound at compile time
+	class BoundEntry : public tui::CdkBound<BoundEntry, tui::CdkEntry>
+	{
+	public:
+		using CdkBound::CdkBound;
+
+		int preKey(chtype key)
+		{
+			return key != 0;
+		}
+	};
+
+	/// Cost of finding the widget of a key, without drawing, then a key sent
+	/// through the handlers bound at compile time
+	void handlerDispatch(tui::CdkScreen & screen)
+	{
+		// Other widgets in the map, as in a real application
+		std::vector<std::unique_ptr<tui::CdkLabel>> labels;
+		for (int n = 0; n < 200; ++n)
+			labels.emplace_back(new tui::CdkLabel(screen, 0, 0, "L", false));
+		DispatchProbe probe(screen, 1, 1, "", "Name", vMIXED, 20, 0, 20);
+		int accepted = 0;
+		run("handler_dispatch_lookup", options.ops * 10, [&](std::size_t n)
+		{
+			accepted += probe.lookupDispatch(static_cast<chtype>('a' + n % 26));
+		});
+		run("handler_dispatch_client_data", options.ops * 10, [&](std::size_t n)
+		{
+			accepted += probe.clientDataDispatch(static_cast<chtype>('a' + n % 26));
+		});
+		labels.clear();
+
+		BoundEntry entry(screen, 1, 3, "", "Bound", vMIXED, 20, 0, 20);
+		screen.refresh();
+		run("key_dispatch_bound", options.ops, [&](std::size_t n)
+		{
+			if (n % 20 == 0)
+				entry.clear();
+			entry.inject(static_cast<chtype>('a' + n % 26));
+			screen.commit();
+		});
+		if (accepted == 0)
+			std::fprintf(stderr, "no key accepted\n");
+	}
+
+	/// Fuzzy list of a million items. One operation is one key typed in the
+	/// query, its latency is the time until the first frame of the new query
+	/// is composed (the filtering goes on in the next frames)
+	void fuzzyFilter(tui::CdkScreen & screen)
+	{
+		const std::size_t count = 1000000;
+		auto items = [](std::size_t index, std::string & text)
+		{
+			char digits[24];
+			auto end = std::to_chars(digits, digits + sizeof(digits), index * 2654435761u % 1000003).ptr;
+			text.append("log_");
+			text.append(digits, end);
+			text.append(index % 3 == 0 ? "_error.txt" : "_trace.dat");
+		};
+		std::unique_ptr<tui::CdkFuzzyList> list;
+		run("fuzzy_filter_build", 1, [&](std::size_t)
+		{
+			list.reset(new tui::CdkFuzzyList(screen, 0, 0, screen.h(), screen.w() / 2, "Files", count, items));
+			screen.refresh();
+		});
+		if (!list)
+			return;
+		// Typing then erasing a query, each key changes it
+		static const char * keys[] = {"l", "lo", "lo1", "lo12", "lo12e", "lo12er", "lo12e", "lo12",
+			"lo1", "lo", "l", "t", "tr", "tra", "tr", "t"};
+		run("fuzzy_filter_key", std::max<std::size_t>(options.ops / 100, 32), [&](std::size_t n)
+		{
+			list->setQuery(keys[n % (sizeof(keys) / sizeof(keys[0]))]);
+			screen.commit();
+		});
+		list.reset();
+		screen.erase();
+	}
+
+	/// Bytes allocated on the heap
+	std::size_t heapInUse()
+	{
+		return mallinfo2().uordblks;
+	}
+
+	/// Screen with list widgets built and torn down again and again. The arena
+	/// of each screen must reserve the same memory, and the heap must not grow
+	/// from one screen to the next
+	void screenCycles(tui::CdkScreen & screen)
+	{
+		std::vector<std::string> items;
+		for (int n = 0; n < 50; ++n)
+			items.push_back("Item " + std::to_string(n));
+		std::vector<std::size_t> reserved;
+		std::vector<std::size_t> heap;
+		run("screen_cycle", std::max<std::size_t>(options.ops / 200, 10), [&](std::size_t)
+		{
+			{
+				tui::CdkScreen cycle(0, 0, screen.w(), screen.h());
+				tui::CdkRadio radio(cycle, 0, 0, RIGHT, 10, 20, "Radio", items);
+				tui::CdkButtonbox buttons(cycle, 22, 0, 5, 40, "Buttons", 2, 4,
+						std::vector<std::string>(items.begin(), items.begin() + 8), A_REVERSE, true);
+				tui::CdkSelection selection(cycle, 64, 0, 10, 30, RIGHT, "Selection", items);
+				cycle.refresh();
+				reserved.push_back(cycle.getArena().bytesReserved());
+			}
+			heap.push_back(heapInUse());
+		});
+		if (reserved.empty())
+			return;
+		auto range = std::minmax_element(reserved.begin(), reserved.end());
+		// The first screen pays for the lazy allocations of curses and CDK
+		auto growth = static_cast<long long>(heap.back()) - static_cast<long long>(heap.front());
+		std::printf("{\"name\":\"screen_cycle_memory\",\"screens\":%zu,\"arena_reserved\":%zu,"
+				"\"arena_reserved_spread\":%zu,\"heap_growth\":%lld}\n",
+				reserved.size(), *range.second, *range.second - *range.first, growth);
+		if (*range.first != *range.second || growth > 0)
+		{
+			std::fprintf(stderr, "screen_cycle: the memory grows from one screen to the next\n");
+			failed = true;
+		}
+		std::fflush(stdout);
+	}
+
+#ifdef TUI_COROUTINES
+	/// Flow waiting for the text of an entry
+	tui::Flow waitEntry(tui::CdkEntry & entry)
+	{
+		auto name = co_await entry.input();
+		(void)name;
+	}
+
+	/// Memory of the flows suspended on entries, then the memory left once the
+	/// entries have been destroyed, which destroys the flows
+	void flowMemory(tui::CdkScreen & screen)
+	{
+		const char * name = "flow_memory";
+		if (!options.filter.empty() && std::string(name).find(options.filter) == std::string::npos)
+			return;
+		auto count = std::max<std::size_t>(options.ops / 20, 1);
+		std::vector<std::unique_ptr<tui::CdkEntry>> entries;
+		for (std::size_t n = 0; n < count; ++n)
+			entries.emplace_back(new tui::CdkEntry(screen, 1, 1, "", "Name", vMIXED, 20, 0, 20));
+		auto before = heapInUse();
+		for (auto & entry : entries)
+			waitEntry(*entry);
+		auto suspended = heapInUse();
+		// The flows and the entries, the entries being destroyed last
+		for (auto & entry : entries)
+			tui::CdkApp::releaseFocus(entry.get());
+		auto released = heapInUse();
+		entries.clear();
+		screen.erase();
+		std::printf("{\"name\":\"%s\",\"flows\":%zu,\"bytes_per_flow\":%.1f,\"leaked_bytes\":%lld}\n",
+				name, count, double(suspended - before) / count,
+				static_cast<long long>(released) - static_cast<long long>(before));
+		std::fflush(stdout);
+	}
+#endif
+
+	/// Screen of ten thousand labels: creation, full refresh and the update of
+	/// a single label among them
+	void largeScreen(tui::CdkScreen & screen)
+	{
+		const std::size_t count = 10000;
+		std::vector<std::unique_ptr<tui::CdkLabel>> labels;
+		labels.reserve(count);
+		auto rows = std::max(screen.h() - 1, 1);
+		auto columns = std::max(screen.w() / 8, 1);
+		run("screen_10k_construction", 1, [&](std::size_t)
+		{
+			for (std::size_t n = 0; n < count; ++n)
+			{
+				auto cell = static_cast<int>(n) % (rows * columns);
+				labels.emplace_back(new tui::CdkLabel(screen, cell % columns * 8, cell / columns, "L" + std::to_string(n), false));
+			}
+			screen.refresh();
+		});
+		run("screen_10k_refresh", std::max<std::size_t>(options.ops / 1000, 5), [&screen](std::size_t)
+		{
+			screen.refresh();
+		});
+		run("screen_10k_set_value", options.ops, [&](std::size_t n)
+		{
+			labels[n * 7919 % count]->setValue("V" + std::to_string(n % 100000));
+			screen.commit();
+		});
+		labels.clear();
+		screen.erase();
+	}
+
+	/// Grid of numeric readouts, all updated for each frame. One operation is
+	/// one readout update, so ops_per_sec is the number of updates per second
+	void readoutGrid(tui::CdkScreen & screen)
+	{
+		std::vector<std::unique_ptr<tui::CdkNumericReadout>> readouts;
+		for (int row = 0; row < screen.h(); ++row)
+			for (int col = 0; col + 20 <= screen.w(); col += 20)
+				readouts.emplace_back(new tui::CdkNumericReadout(screen, col, row, 20, "v ", 3, false));
+		screen.refresh();
+		run("readout_grid_updates", options.ops * 10, [&](std::size_t n)
+		{
+			readouts[n % readouts.size()]->setValue(static_cast<double>(n % 100003) / 7);
+			// A frame each time the whole grid has been updated
+			if ((n + 1) % readouts.size() == 0)
+				screen.commit();
+		});
+		readouts.clear();
+		screen.erase();
+	}
+
+	bool parseOptions(int argc, char ** argv)
+	{
+		for (int n = 1; n < argc; ++n)
+		{
+			std::string arg = argv[n];
+			if (n + 1 == argc)
+				return false;
+			std::string value = argv[++n];
+			if (arg == "--filter")
+				options.filter = value;
+			else if (arg == "--ops")
+				options.ops = std::max<std::size_t>(std::strtoull(value.c_str(), nullptr, 10), 20);
+			else if (arg == "--rows")
+				options.rows = std::atoi(value.c_str());
+			else if (arg == "--cols")
+				options.cols = std::atoi(value.c_str());
+			else
+				return false;
+		}
+		return options.rows > 0 && options.cols > 0;
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	if (!parseOptions(argc, argv))
+	{
+		std::fprintf(stderr, "usage: %s [--filter text] [--ops count] [--rows rows] [--cols cols]\n", argv[0]);
+		return 2;
+	}
+	auto app = tui::CdkApp::startHeadless(options.rows, options.cols);
+	{
+		tui::CdkScreen screen;
+		widgetConstruction(screen);
+		labelSetValue(screen);
+		screen.erase();
+		sliderSetValue(screen);
+		screen.erase();
+		fullRefresh(screen);
+		keyDispatch(screen);
+		screen.erase();
+		handlerDispatch(screen);
+		screen.erase();
+#ifdef TUI_COROUTINES
+		flowMemory(screen);
+#endif
+		screenCycles(screen);
+		screen.erase();
+		fuzzyFilter(screen);
+		largeScreen(screen);
+		readoutGrid(screen);
+	}
+	delete app;
+	return failed ? 1 : 0;
+}
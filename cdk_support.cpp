@@ -1,5 +1,10 @@
 #include "cdk_support.h"
 #include "mutex" // Needed for the once_flag
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <unistd.h>
 
 // Definition of the static variables for the CdkApp class
 
@@ -19,6 +24,192 @@ std::unordered_map< void *, tui::CdkWidget *> tui::CdkApp::objectMap;
 
 ******************************************************************************/
 
+tui::CdkApp::CdkApp(std::unique_ptr<HeadlessTerminal> terminal)
+	: headless(std::move(terminal))
+{
+	if (headless)
+	{
+		inputFd = headless->getInputFd();
+		outputFd = headless->getOutputFd();
+	}
+	Window::setFrameScheduler(&frameScheduler);
+	// The posted updates are run as soon as the loop wakes up
+	eventLoop.addFd(updates.getFd(), EPOLLIN, [this](std::uint32_t){ updates.drain(); });
+}
+
+void tui::CdkApp::focus(CdkWidget & widget, std::function<void(EExitType)> done)
+{
+	focusQueue.emplace_back(&widget, std::move(done));
+	if (focusQueue.size() == 1)
+		widget.draw();
+}
+
+void tui::CdkApp::releaseFocus(CdkWidget * widget)
+{
+	if (app == nullptr)
+		return;
+	auto & queue = app->focusQueue;
+	bool hadFocus = !queue.empty() && queue.front().first == widget;
+	// The done functions are destroyed once the queue is updated: destroying
+	// a flow waiting on the widget may destroy other widgets
+	std::vector<std::function<void(EExitType)>> released;
+	auto end = std::stable_partition(queue.begin(), queue.end(),
+			[widget](const decltype(app->focusQueue)::value_type & item){ return item.first != widget; });
+	for (auto item = end; item != queue.end(); ++item)
+		released.push_back(std::move(item->second));
+	queue.erase(end, queue.end());
+	released.clear();
+	// The next widget waiting for the focus gets it
+	if (hadFocus && !queue.empty())
+		queue.front().first->draw();
+}
+
+void tui::CdkApp::run()
+{
+	// The keys are read from a dedicated pad so that reading a key never
+	// refreshes a window behind the back of the frame scheduler: wgetch
+	// refreshes a touched window, but never a pad
+	if (inputWin == nullptr)
+	{
+		inputWin = newpad(1, 1);
+		keypad(inputWin, TRUE);
+		nodelay(inputWin, TRUE);
+		eventLoop.addFd(inputFd, EPOLLIN, [this](std::uint32_t){ readKeys(); });
+	}
+	frameScheduler.flush();
+	// The loop only wakes up for the input, the updates, the timers and the
+	// frames which are waiting for the end of the frame interval
+	running = true;
+	while (running)
+	{
+		auto wait = std::chrono::milliseconds(-1);
+		if (frameScheduler.pending())
+			wait = std::chrono::ceil<std::chrono::milliseconds>(frameScheduler.timeToNextFrame());
+		eventLoop.runOnce(wait);
+		frameScheduler.tick();
+	}
+}
+
+void tui::CdkApp::readKeys()
+{
+	int key{};
+	while ((key = wgetch(inputWin)) != ERR)
+		dispatchKey(key);
+	// The end marker of a paste may never come, for instance if the terminal
+	// is reset: the paste is ended when the input stops for a while
+	if (pasting)
+	{
+		eventLoop.removeTimer(pasteTimer);
+		pasteTimer = eventLoop.addTimer(pasteTimeout, std::chrono::nanoseconds(0), [this]()
+				{
+					pasteTimer = -1;
+					if (pasting)
+						endPaste();
+				});
+	}
+}
+
+void tui::CdkApp::setOutputAccounting(bool enable, bool perWidget)
+{
+	frameScheduler.setOutputMeter(nullptr);
+	outputMeter.reset();
+	if (enable)
+	{
+		outputMeter.reset(new OutputMeter(perWidget));
+		frameScheduler.setOutputMeter(outputMeter.get());
+	}
+}
+
+void tui::CdkApp::setBracketedPaste(bool enable)
+{
+	if (enable == bracketedPaste)
+		return;
+	bracketedPaste = enable;
+	if (enable)
+	{
+		// The terminal sends ESC [ 200 ~ before the text and ESC [ 201 ~ after
+		define_key("\033[200~", keyPasteBegin);
+		define_key("\033[201~", keyPasteEnd);
+		putp("\033[?2004h");
+	}
+	else
+	{
+		putp("\033[?2004l");
+		define_key("\033[200~", 0);
+		define_key("\033[201~", 0);
+	}
+}
+
+void tui::CdkApp::dispatchKey(int key)
+{
+	// The keys between the paste markers are collected, the paste may be read
+	// in several batches
+	if (key == keyPasteBegin)
+	{
+		pasting = true;
+		pasteBuffer.clear();
+		return;
+	}
+	if (pasting)
+	{
+		if (key == keyPasteEnd)
+			endPaste();
+		else if (key >= 0 && key < 256)
+		{
+			pasteBuffer += static_cast<char>(key);
+			// The memory of a paste is bounded, a large one is sent in parts
+			if (pasteBuffer.size() >= maxPaste)
+			{
+				dispatchPaste();
+				pasteBuffer.clear();
+			}
+		}
+		return;
+	}
+	if (focusQueue.empty())
+	{
+		if (keyHandler)
+			keyHandler(key);
+		return;
+	}
+	exitFocus(focusQueue.front().first->inject(key));
+}
+
+void tui::CdkApp::endPaste()
+{
+	pasting = false;
+	eventLoop.removeTimer(pasteTimer);
+	pasteTimer = -1;
+	dispatchPaste();
+	pasteBuffer.clear();
+}
+
+void tui::CdkApp::dispatchPaste()
+{
+	if (focusQueue.empty())
+	{
+		if (keyHandler)
+			for (auto c : pasteBuffer)
+				keyHandler(static_cast<unsigned char>(c));
+		return;
+	}
+	exitFocus(focusQueue.front().first->paste(pasteBuffer));
+}
+
+void tui::CdkApp::exitFocus(EExitType exitType)
+{
+	if (exitType == vEARLY_EXIT)
+		return;
+	// The widget is done: the focus goes to the next one before calling done
+	// so that done can give the focus again
+	auto done = std::move(focusQueue.front().second);
+	focusQueue.pop_front();
+	if (!focusQueue.empty())
+		focusQueue.front().first->draw();
+	if (done)
+		done(exitType);
+}
+
 
 /******************************************************************************
 
@@ -26,12 +217,125 @@ std::unordered_map< void *, tui::CdkWidget *> tui::CdkApp::objectMap;
 
 ******************************************************************************/
 
+namespace
+{
+	/// Name of a type of widget in the output counters
+	const char * objectTypeName(EObjectType type)
+	{
+		switch (type)
+		{
+			case vNULL: return "curses";
+			case vBUTTONBOX: return "buttonbox";
+			case vENTRY: return "entry";
+			case vFSLIDER: return "fslider";
+			case vLABEL: return "label";
+			case vMENU: return "menu";
+			case vRADIO: return "radio";
+			case vSELECTION: return "selection";
+			default: return "other";
+		}
+	}
+}
+
 void tui::CdkScreen::drawTitle(const std::string & str)
 {
+	// The title is cosmetic, it waits while the terminal is congested
+	if (CdkApp::getCdkApp()->getFrameScheduler().deferCosmetic(this, [this, str]{ drawTitle(str); }))
+		return;
 	titleWidget = std::unique_ptr<CdkLabel>(new CdkLabel(*this, w()/2 - str.size() /2, 0, str.c_str(), false));
 	titleWidget->draw();
 }
 
+/// Full redraw of all the registered widgets. Since every widget is drawn, the
+/// pending dirty widgets do not need to be redrawn at the next commit.
+void tui::CdkScreen::refresh()
+{
+	refreshCDKScreen(pObj);
+	for (auto pWidget : dirtyWidgets)
+		pWidget->dirty = false;
+	dirtyWidgets.clear();
+	// CDK does not know the widgets drawn with curses
+	for (auto pWidget : cursesWidgets)
+		pWidget->render(pWidget->boxed);
+	if (!cursesWidgets.empty())
+		commit();
+}
+
+void tui::CdkScreen::erase()
+{
+	eraseCDKScreen(pObj);
+	for (auto pWidget : cursesWidgets)
+		pWidget->erase();
+}
+
+/// The dirty widgets are drawn when the frame scheduler composes the next frame.
+/// Without frame rate limitation this happens immediately.
+void tui::CdkScreen::commit()
+{
+	CdkApp::getCdkApp()->getFrameScheduler().request();
+}
+
+/// Redraw the dirty widgets only. The screen window and the widgets drawn with
+/// curses (CursesWidget) are staged with wnoutrefresh and reach the terminal
+/// with the single doupdate of the frame. The draw functions of CDK call
+/// wrefresh themselves: each dirty CDK widget is sent to the terminal when it
+/// is rendered, with a flush of its own counted by
+/// FrameScheduler::sourceFlushCount.
+void tui::CdkScreen::compose()
+{
+	auto & scheduler = CdkApp::getCdkApp()->getFrameScheduler();
+	auto meter = scheduler.getOutputMeter();
+	if (meter != nullptr && meter->isPerWidget())
+	{
+		// Each widget is sent to the terminal alone to know what it costs
+		for (auto pWidget : dirtyWidgets)
+		{
+			pWidget->dirty = false;
+			auto before = meter->read();
+			pWidget->render(pWidget->boxed);
+			if (pWidget->flushesOnRender())
+				scheduler.countSourceFlush();
+			wnoutrefresh(pCppCurseWin->getPtr());
+			meter->update();
+			auto output = meter->read() - before;
+			pWidget->outputCounters += output;
+			meter->addWidget(objectTypeName(pWidget->getObjType()), output);
+		}
+		dirtyWidgets.clear();
+	}
+	for (auto pWidget : dirtyWidgets)
+	{
+		pWidget->dirty = false;
+		pWidget->render(pWidget->boxed);
+		if (pWidget->flushesOnRender())
+			scheduler.countSourceFlush();
+	}
+	dirtyWidgets.clear();
+	wnoutrefresh(pCppCurseWin->getPtr());
+}
+
+/// Record a widget which must be redrawn at the next commit
+void tui::CdkScreen::invalidate(CdkWidget * pWidget)
+{
+	dirtyWidgets.push_back(pWidget);
+}
+
+/// Remove a widget from the list of the widgets to redraw
+void tui::CdkScreen::forget(CdkWidget * pWidget)
+{
+	dirtyWidgets.erase(std::remove(dirtyWidgets.begin(), dirtyWidgets.end(), pWidget), dirtyWidgets.end());
+}
+
+void tui::CdkScreen::attachWidget(CdkWidget * pWidget)
+{
+	cursesWidgets.push_back(pWidget);
+}
+
+void tui::CdkScreen::detachWidget(CdkWidget * pWidget)
+{
+	cursesWidgets.erase(std::remove(cursesWidgets.begin(), cursesWidgets.end(), pWidget), cursesWidgets.end());
+}
+
 
 
 /// Unregister a widget from the screen so that it is not refreshed anymore
@@ -53,6 +357,17 @@ void tui::CdkScreen::registerWidget(CdkWidget * pWidget)
 
 ******************************************************************************/
 
+EExitType tui::CdkWidget::paste(const std::string & text)
+{
+	for (auto c : text)
+	{
+		auto exitType = inject(static_cast<unsigned char>(c));
+		if (exitType != vEARLY_EXIT)
+			return exitType;
+	}
+	return vEARLY_EXIT;
+}
+
 /******************************************************************************
 
   CDK  Entry Widget
@@ -60,3 +375,200 @@ void tui::CdkScreen::registerWidget(CdkWidget * pWidget)
 ******************************************************************************/
 
 
+
+void tui::CdkEntry::setValidator(Validator desired)
+{
+	validator = desired;
+	// Sized once so that checking a key does not allocate
+	validated.clear();
+	validated.reserve(pObj->max + 1);
+	states.assign(pObj->max + 2, Validator::start);
+}
+
+tui::Validator::State tui::CdkEntry::validatedState(const char * value, std::size_t length)
+{
+	// The states of the prefix shared with the last value checked are known
+	std::size_t common = 0;
+	while (common < length && common < validated.size() && validated[common] == value[common])
+		++common;
+	if (length + 1 > states.size())
+		states.resize(length + 1);
+	validated.assign(value, length);
+	for (auto i = common; i < length; ++i)
+		states[i + 1] = validator.next(states[i], value[i]);
+	return states[length];
+}
+
+int tui::CdkEntry::preProcess(chtype input)
+{
+	if (validator)
+	{
+		auto value = getValue() != nullptr ? getValue() : "";
+		auto length = std::strlen(value);
+		if (input >= ' ' && input < 127)
+		{
+			auto position = std::min<std::size_t>(pObj->screenCol + pObj->leftChar, length);
+			validatedState(value, length);
+			// Typing at the end of the value is one transition, an insertion
+			// checks the characters after it again
+			auto state = validator.next(states[position], static_cast<char>(input));
+			if (position < length)
+				state = validator.run(value + position, length - position, state);
+			if (state == Validator::dead)
+			{
+				beep();
+				return 0;
+			}
+		}
+		else if (input == KEY_ENTER || input == '\n' || input == '\r' || (input == KEY_TAB && completion == nullptr))
+		{
+			if (!validator.isAccepting(validatedState(value, length)))
+			{
+				beep();
+				return 0;
+			}
+		}
+	}
+	if (completion == nullptr || input != KEY_TAB)
+		return 1;
+	auto value = getValue();
+	std::string prefix(value != nullptr ? value : "");
+	auto completed = completion->commonPrefix(prefix);
+	if (completed.size() > prefix.size())
+	{
+		setCDKEntryValue(pObj, completed.c_str());
+		// CDK does not draw the entry for a consumed key
+		invalidate();
+		screenPtr->commit();
+	}
+	// The key is consumed: Tab does not exit the entry
+	return 0;
+}
+
+std::vector<std::string> tui::CdkEntry::getCompletions(std::size_t k) const
+{
+	if (completion == nullptr)
+		return {};
+	auto value = getValue();
+	return completion->complete(value != nullptr ? value : "", k);
+}
+
+namespace
+{
+	/// True if the display type of an entry accepts a character
+	bool acceptsChar(EDisplayType type, char c)
+	{
+		auto u = static_cast<unsigned char>(c);
+		if (u < ' ' || u == 127)
+			return false;
+		switch (type)
+		{
+			case vINT:
+			case vHINT:
+				return std::isdigit(u);
+			case vCHAR:
+			case vHCHAR:
+			case vUCHAR:
+			case vLCHAR:
+			case vUHCHAR:
+			case vLHCHAR:
+				return std::isalpha(u);
+			case vVIEWONLY:
+				return false;
+			default:
+				return true;
+		}
+	}
+}
+
+EExitType tui::CdkEntry::paste(const std::string & text)
+{
+	std::string value(getValue() != nullptr ? getValue() : "");
+	auto position = std::min<std::size_t>(pObj->screenCol + pObj->leftChar, value.size());
+	auto room = pObj->max > static_cast<int>(value.size()) ? pObj->max - value.size() : 0;
+	std::string inserted;
+	inserted.reserve(std::min(text.size(), room));
+	for (auto c : text)
+	{
+		if (inserted.size() == room)
+			break;
+		if (acceptsChar(pObj->dispType, c))
+			inserted += c;
+	}
+	if (inserted.empty())
+		return vEARLY_EXIT;
+	value.insert(position, inserted);
+	// The paste is validated as a whole
+	if (validator && validator.run(value.data(), value.size()) == Validator::dead)
+	{
+		beep();
+		return vEARLY_EXIT;
+	}
+	auto leftChar = pObj->leftChar;
+	setCDKEntryValue(pObj, value.c_str());
+	// setCDKEntryValue puts the cursor at the end of the value: it goes back
+	// after the inserted text, scrolling the field only if it is not visible
+	auto cursor = static_cast<int>(position + inserted.size());
+	auto width = std::max(pObj->fieldWidth, 1);
+	if (cursor < leftChar || cursor - leftChar >= width)
+		leftChar = std::max(cursor - width + 1, 0);
+	pObj->leftChar = leftChar;
+	pObj->screenCol = cursor - leftChar;
+	postProcess(CdkApp::keyPasteEnd);
+	// The text goes to the terminal in the frame of the paste, with the
+	// changes made by the call back
+	draw(boxed);
+	return vEARLY_EXIT;
+}
+
+/******************************************************************************
+
+  CDK Float Slider
+
+******************************************************************************/
+
+tui::CdkFSlider::Display tui::CdkFSlider::displayOf(float value) const
+{
+	// Same computation as the field drawn by CDK
+	Display display{};
+	auto range = pObj->high - pObj->low;
+	display.bar = range > 0 ? static_cast<int>((value - pObj->low) * (pObj->fieldWidth / range)) : 0;
+	display.digits = std::llround(value * std::pow(10.0, pObj->digits));
+	return display;
+}
+
+void tui::CdkFSlider::setValue(float val)
+{
+	// Setting the value in CDK is cheap, drawing it is not
+	setCDKFSliderValue(pObj, val);
+	if (!coalescing)
+	{
+		invalidate();
+		return;
+	}
+	if (pendingUpdates == 0 && displayOf(getCDKFSliderValue(pObj)) == drawnDisplay)
+	{
+		// Nothing would change on the screen
+		++dropped;
+		return;
+	}
+	++pendingUpdates;
+	invalidate();
+}
+
+void tui::CdkFSlider::render(bool box)
+{
+	if (coalescing)
+	{
+		// All the values given since the last frame are drawn at once
+		if (pendingUpdates != 0)
+		{
+			++drawn;
+			dropped += pendingUpdates - 1;
+			pendingUpdates = 0;
+		}
+		// The keys may also have changed the value
+		drawnDisplay = displayOf(getCDKFSliderValue(pObj));
+	}
+	drawCDKFSlider(pObj, box);
+}
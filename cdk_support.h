@@ -1,4 +1,13 @@
+#ifndef TUI_CDK_SUPPORT_H
+#define TUI_CDK_SUPPORT_H
+
 #include "curses_support.h"
+#include "completion.h"
+#include "headless.h"
+#include "update_queue.h"
+#include "validator.h"
+#include "event_loop.h"
+#include "selection_model.h"
 #include <cdk_test.h>
 #include <cassert>
 #include <string>
@@ -7,6 +16,17 @@
 #include <unordered_map>
 #include <mutex>
 #include <memory>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#include <exception>
+#define TUI_COROUTINES 1
+#endif
 
 
 namespace tui
@@ -17,6 +37,68 @@ class CdkWidget;
 class CdkLabel;
 class CdkScreen;
 
+/***************************************************************************//*
+Typed call back invoked in the post processing of a widget.
+
+It is made of a plain function pointer and of the object it is bound to. The
+binding to a member function is done at compile time, so invoking the call back
+does not require any lookup or allocation:
+
+	widget.registerCallback(KeyCallback::bind<MyScreen, &MyScreen::onKey>(screen));
+
+******************************************************************************/
+class KeyCallback
+{
+public:
+	KeyCallback() = default;
+
+	/// Bind a member function of obj
+	template <typename T, int (T::*Method)(CdkWidget & widget, chtype key)>
+	static KeyCallback bind(T & obj)
+	{
+		return KeyCallback(&callMember<T, Method>, &obj);
+	}
+
+	/// Bind a free function
+	template <int (*Function)(CdkWidget & widget, chtype key)>
+	static KeyCallback bind()
+	{
+		return KeyCallback(&callFunction<Function>, nullptr);
+	}
+
+	/// Invoke the call back
+	int operator()(CdkWidget & widget, chtype key) const
+	{
+		return fn(obj, widget, key);
+	}
+
+	/// Return true if a function has been bound
+	explicit operator bool() const
+	{
+		return fn != nullptr;
+	}
+
+private:
+	using Thunk = int (*)(void * obj, CdkWidget & widget, chtype key);
+
+	KeyCallback(Thunk thunk, void * object) : fn(thunk), obj(object) {}
+
+	template <typename T, int (T::*Method)(CdkWidget &, chtype)>
+	static int callMember(void * obj, CdkWidget & widget, chtype key)
+	{
+		return (static_cast<T *>(obj)->*Method)(widget, key);
+	}
+
+	template <int (*Function)(CdkWidget &, chtype)>
+	static int callFunction(void *, CdkWidget & widget, chtype key)
+	{
+		return Function(widget, key);
+	}
+
+	Thunk fn = nullptr;
+	void * obj = nullptr;
+};
+
 /***************************************************************************//*
 Conversion of a string into an array of pointer to char. This allow to make
 the conversion between a std::string and the arguments needed by the CDK library
@@ -28,50 +110,63 @@ using CallBack2 = int (CdkScreen::*)(chtype key);
 class ConvertToArrayCharPtr
 {
 public:
+	ConvertToArrayCharPtr() = default;
+
 	ConvertToArrayCharPtr(const std::string & str)
 	{
-		std::string::size_type pos{};
-		std::string::size_type oldPos{};
-		while((pos = str.find('\n', oldPos)) != std::string::npos)
-			{
-				auto tmpSub = str.substr(oldPos, pos-oldPos);
-				rows.push_back(std::move(tmpSub));
-				oldPos = pos + 1;
-			}
-		// We take care of the space after the last <cr>
-		auto tmpSub = str.substr(oldPos);
-		rows.push_back(std::move(tmpSub));
-		auto nRows = rows.size();
-		ptr = new const char*[nRows];
-		auto index = 0;
-		for (auto &row:rows)
+		assign(str);
+	}
+
+	/// Convert a new string. The storage of the previous conversion is reused
+	/// when it is large enough, so repeated conversions do not allocate.
+	void assign(const std::string & str)
+	{
+		auto begin = str.data();
+		auto length = str.size();
+		// The rows are delimited with memchr which is vectorized by the C library
+		std::size_t nRows = 1;
+		for (auto pos = begin; (pos = static_cast<const char *>(std::memchr(pos, '\n', begin + length - pos))) != nullptr; ++pos)
+			++nRows;
+		// A single block holds the array of pointers followed by the characters
+		auto units = nRows + (length + sizeof(char *)) / sizeof(char *);
+		if (units > capacity)
+		{
+			storage.reset(new char *[units]);
+			capacity = units;
+		}
+		auto rows = storage.get();
+		auto text = reinterpret_cast<char *>(rows + nRows);
+		std::memcpy(text, begin, length);
+		text[length] = '\0';
+		// Each '\n' becomes the end of a row
+		rows[0] = text;
+		auto end = text + length;
+		std::size_t index = 1;
+		for (auto pos = text; (pos = static_cast<char *>(std::memchr(pos, '\n', end - pos))) != nullptr; )
 		{
-			ptr[index] = row.c_str();
-			++index;
+			*pos++ = '\0';
+			rows[index++] = pos;
 		}
+		nbrRows = nRows;
 	}
 
 	char ** getPtr()
 	{
-		return const_cast<char**>(ptr);
+		return storage.get();
 	}
 
 	int size()
 	{
-		return  rows.size();
-	}
-
-	~ConvertToArrayCharPtr()
-	{
-		delete[] ptr;
-
+		return  nbrRows;
 	}
 
 private:
-	/// vector containing one string per row
-	std::vector<std::string> rows{};
-	/// Pointer to an array of pointers to const char
-	const char ** ptr = nullptr;
+	/// Array of pointers to the rows followed by the characters of the rows
+	std::unique_ptr<char *[]> storage{};
+	/// Size of the storage in number of pointers
+	std::size_t capacity{};
+	/// Number of rows of the last conversion
+	std::size_t nbrRows{};
 
 };
 
@@ -108,6 +203,116 @@ private:
 
 };
 
+/***************************************************************************//*
+Monotonic memory arena owning the buffers given to CDK by the widgets of a
+screen, such as the arrays of items of the list widgets. The memory is obtained from large blocks and is
+only given back, in one shot, when the arena is released or destroyed. This
+avoids both the scattered small allocations and the need to track each buffer.
+
+******************************************************************************/
+class ScreenArena
+{
+public:
+	/// Create an arena allocating blocks of at least blockSize bytes
+	explicit ScreenArena(std::size_t blockSize = 4096) : blockSize(blockSize) {}
+
+	ScreenArena(const ScreenArena &) = delete;
+	ScreenArena & operator=(const ScreenArena &) = delete;
+
+	~ScreenArena()
+	{
+		release();
+	}
+
+	/// Allocate size bytes aligned on align (a power of two)
+	void * allocate(std::size_t size, std::size_t align = alignof(std::max_align_t))
+	{
+		auto address = reinterpret_cast<std::uintptr_t>(cursor);
+		auto aligned = (address + align - 1) & ~(static_cast<std::uintptr_t>(align) - 1);
+		if (cursor == nullptr || aligned + size > reinterpret_cast<std::uintptr_t>(limit))
+		{
+			addBlock(size + align);
+			address = reinterpret_cast<std::uintptr_t>(cursor);
+			aligned = (address + align - 1) & ~(static_cast<std::uintptr_t>(align) - 1);
+		}
+		cursor = reinterpret_cast<char *>(aligned + size);
+		used += size;
+		return reinterpret_cast<void *>(aligned);
+	}
+
+	/// Copy a string in the arena
+	char * copyString(const std::string & str)
+	{
+		auto copy = static_cast<char *>(allocate(str.size() + 1, 1));
+		std::memcpy(copy, str.c_str(), str.size() + 1);
+		return copy;
+	}
+
+	/// Return an array of pointers to the strings of a list, as expected by
+	/// the CDK list widgets. Only the array is in the arena: the pointers refer
+	/// to the strings of list, which CDK copies when it creates the widget
+	char ** pointerList(const std::vector<std::string> & list)
+	{
+		auto ptr = static_cast<char **>(allocate(list.size() * sizeof(char *), alignof(char *)));
+		for (std::size_t index = 0; index < list.size(); ++index)
+			ptr[index] = const_cast<char *>(list[index].c_str());
+		return ptr;
+	}
+
+	/// Give back all the memory of the arena. The pointers obtained from the
+	/// arena are no longer valid
+	void release()
+	{
+		while (blocks != nullptr)
+		{
+			auto next = blocks->next;
+			delete[] reinterpret_cast<char *>(blocks);
+			blocks = next;
+		}
+		cursor = limit = nullptr;
+		used = 0;
+		reserved = 0;
+	}
+
+	/// Number of bytes handed out by the arena
+	std::size_t bytesUsed() const
+	{
+		return used;
+	}
+
+	/// Number of bytes obtained from the heap by the arena
+	std::size_t bytesReserved() const
+	{
+		return reserved;
+	}
+
+private:
+	/// Header of each block, followed by the memory handed out
+	struct Block
+	{
+		Block * next;
+	};
+
+	/// Get a new block able to hold at least size bytes
+	void addBlock(std::size_t size)
+	{
+		auto bytes = std::max(size, blockSize) + sizeof(Block);
+		auto block = reinterpret_cast<Block *>(new char[bytes]);
+		block->next = blocks;
+		blocks = block;
+		cursor = reinterpret_cast<char *>(block + 1);
+		limit = reinterpret_cast<char *>(block) + bytes;
+		reserved += bytes;
+	}
+
+	std::size_t blockSize;
+	Block * blocks = nullptr;	//< Last block allocated
+	char * cursor = nullptr;	//< Next free byte of the current block
+	char * limit = nullptr;	//< End of the current block
+	std::size_t used{};
+	std::size_t reserved{};
+};
+
 /****************************************************************************//*
 Main application to create CDK objects.
 
@@ -118,9 +323,25 @@ class CdkApp
 {
 	
 public:
+	/// Key codes framing a bracketed paste
+	static constexpr int keyPasteBegin = KEY_MAX + 1;
+	static constexpr int keyPasteEnd = KEY_MAX + 2;
+
 	~CdkApp()
 	{
+		// The flows still waiting for the focus are destroyed while the
+		// screens exist
+		auto pending = std::move(focusQueue);
+		focusQueue.clear();
+		pending.clear();
+		Window::setFrameScheduler(nullptr);
+		setBracketedPaste(false);
+		if (inputWin != nullptr)
+			delwin(inputWin);
 	   	endCDK();
+		if (outputDump && outputMeter)
+			outputMeter->dump(stderr);
+		app = nullptr;
 	}
 
 	/// Returns the main curses window stdscr
@@ -129,15 +350,153 @@ public:
 		return mainWindow;
 	}
 
+	/// Returns the scheduler composing the output of all the screens into frames
+	FrameScheduler & getFrameScheduler()
+	{
+		return frameScheduler;
+	}
+
+	/// Set the maximum number of frames sent to the terminal per second. With zero
+	/// (the default) every draw is sent to the terminal immediately. Otherwise
+	/// the draws are coalesced and displayed by tick().
+	void setMaxFrameRate(unsigned fps)
+	{
+		frameScheduler.setMaxFrameRate(fps);
+	}
+
+	/// Run the updates posted by the other threads, then display the pending
+	/// frame if the frame interval has elapsed. This must be called periodically
+	/// by the application when a frame rate is set or when updates are posted.
+	bool tick()
+	{
+		updates.drain();
+		return frameScheduler.tick();
+	}
+
+	/// Post an update to be run by the curses thread at the next tick. This is the
+	/// only CdkApp function which can be called from any thread, for instance:
+	///
+	///		app->post([&label, text]{ label.setValue(text); });
+	///
+	/// The CdkApp must have been created before the producer threads use it.
+	void post(UpdateQueue::Update update)
+	{
+		updates.post(std::move(update));
+	}
+
+	/// Run the posted updates without waiting for the next tick. At most
+	/// maxUpdates are run, the others are left for the next call.
+	std::size_t processUpdates(std::size_t maxUpdates = 4096)
+	{
+		return updates.drain(maxUpdates);
+	}
+
+	/// File descriptor which becomes readable when updates have been posted.
+	/// The application waits on it instead of polling the queue.
+	int getUpdateFd() const
+	{
+		return updates.getFd();
+	}
+
+	/// Returns the event loop of the application. Timers, events and other file
+	/// descriptors can be added to it; they are serviced while a widget has the focus.
+	EventLoop & getEventLoop()
+	{
+		return eventLoop;
+	}
+
+	/// Give the keyboard focus to a widget. The keys read by run() are injected
+	/// in the widget until it exits, then done is called with the exit type.
+	/// If another widget has the focus, the widget waits for its turn.
+	void focus(CdkWidget & widget, std::function<void(EExitType)> done = nullptr);
+
+	/// Remove a widget from the widgets having or waiting for the focus. Its
+	/// done function is not called but destroyed, which destroys a flow
+	/// waiting on the widget.
+	static void releaseFocus(CdkWidget * widget);
+
+	/// Return the widget which has the keyboard focus, nullptr if none
+	CdkWidget * getFocus() const
+	{
+		return focusQueue.empty() ? nullptr : focusQueue.front().first;
+	}
+
+	/// Set the function receiving the keys when no widget has the focus
+	void setKeyHandler(std::function<void(int key)> handler)
+	{
+		keyHandler = std::move(handler);
+	}
+
+	/// Ask the terminal to frame the pasted text with escape sequences. A paste
+	/// is then given at once to the paste function of the widget having the
+	/// focus instead of being processed one key at a time
+	void setBracketedPaste(bool enable);
+
+	/// Run the event loop until stop() is called. The keys, the posted updates,
+	/// the timers and the frames are all serviced from this loop; it does not
+	/// wake up when there is nothing to do.
+	void run();
+
+	/// Adapt the frames to the speed of the terminal. When more than maxPending
+	/// bytes are waiting to be sent (512 bytes are half a second at 9600 bauds)
+	/// the frames are slowed down and the cosmetic redraws wait. The keys are
+	/// still read and processed while the frames wait
+	void setBackpressure(bool enable, std::size_t maxPending = 512)
+	{
+		frameScheduler.setBackpressure(enable ? outputFd : -1, maxPending);
+	}
+
+	/// Count the output sent to the terminal. With perWidget, each widget
+	/// redraw is sent to the terminal on its own and counted, which costs a
+	/// terminal update per widget. Must be called by the curses thread.
+	/// Throws std::system_error if the output cannot be measured
+	void setOutputAccounting(bool enable, bool perWidget = false);
+
+	/// Return the meter of the output, nullptr if the output is not counted
+	const OutputMeter * getOutputMeter() const
+	{
+		return outputMeter.get();
+	}
+
+	/// Print the output counters to stderr when the application is destroyed,
+	/// once the terminal is restored
+	void setOutputDump(bool enable)
+	{
+		outputDump = enable;
+	}
+
+	/// Request run() to return
+	void stop()
+	{
+		running = false;
+	}
+
 	static CdkApp * getCdkApp()
 	{
 		if (app == nullptr)
-			app = new CdkApp;
+			app = new CdkApp(nullptr);
 
 		//std::call_once(alreadyCreated, []()mutable{app = new CdkApp;});
 		return app;
 	}
 
+	/// Create the application on a headless terminal of rows x cols instead
+	/// of the terminal of the process. It must be called before getCdkApp().
+	/// The keys are sent and the frames read through getHeadless()
+	static CdkApp * startHeadless(int rows, int cols)
+	{
+		assert(app == nullptr);
+		app = new CdkApp(std::unique_ptr<HeadlessTerminal>(new HeadlessTerminal(rows, cols)));
+		return app;
+	}
+
+	/// Return the headless terminal, nullptr if the application runs on the
+	/// terminal of the process
+	HeadlessTerminal * getHeadless()
+	{
+		return headless.get();
+	}
+
 	/// Add a new CdkWidget to the internal application map
 	static void  addObject( void * cdkPtr, CdkWidget * widgetPtr)
 	{
@@ -162,15 +521,65 @@ public:
 	}
 
 private:
-	/// Constructor. It also initializes ncurses
-	/// It is private because only the factory getCdkApp can call this object
- 	CdkApp()
-	{
-	};
+	/// Constructor. It also initializes ncurses, on the headless terminal if
+	/// one is given
+	/// It is private because only the factories getCdkApp and startHeadless
+	/// can call this object
+	explicit CdkApp(std::unique_ptr<HeadlessTerminal> terminal);
+
+	/// Read the available keys without blocking and dispatch them
+	void readKeys();
+	/// Send a key to the widget having the focus
+	void dispatchKey(int key);
+	/// Send the text pasted to the widget having the focus
+	void dispatchPaste();
+	/// End the paste and send the text pasted
+	void endPaste();
+	/// Give the focus to the next widget when the widget having it is exited
+	void exitFocus(EExitType exitType);
 
 
 private:
 
+	/// Scheduler of the terminal updates. It is declared before the main window
+	/// so that it outlives it.
+	FrameScheduler frameScheduler;
+	/// Updates posted by the other threads
+	UpdateQueue updates;
+	/// Loop servicing the input, the updates and the timers
+	EventLoop eventLoop;
+	/// Widgets having (front) or waiting for the focus with their done function
+	std::deque<std::pair<CdkWidget *, std::function<void(EExitType)>>> focusQueue{};
+	/// Function receiving the keys when no widget has the focus
+	std::function<void(int key)> keyHandler{};
+	/// Window used to read the keys without blocking
+	WINDOW * inputWin = nullptr;
+	/// True while run() is executing
+	bool running = false;
+	/// True when the terminal frames the pasted text
+	bool bracketedPaste = false;
+	/// True between the start and the end of a paste
+	bool pasting = false;
+	/// Text pasted so far
+	std::string pasteBuffer{};
+	/// Timer ending a paste whose end marker is lost, -1 if none
+	int pasteTimer = -1;
+	/// A larger paste is sent to the widget in several parts
+	static constexpr std::size_t maxPaste = 1 << 20;
+	/// A paste without input for this time is ended
+	static constexpr std::chrono::milliseconds pasteTimeout{500};
+	/// Terminal replacing the one of the process. It is declared before the main
+	/// window so that curses is started on it first
+	std::unique_ptr<HeadlessTerminal> headless;
+	/// File descriptor from which the keys are read, the standard input by default
+	int inputFd = 0;
+	/// File descriptor of the terminal output, the standard output by default
+	int outputFd = 1;
+	/// Accounting of the output sent to the terminal
+	std::unique_ptr<OutputMeter> outputMeter{};
+	/// True to print the output counters when the application is destroyed
+	bool outputDump = false;
+
 	// This will call the default constructor which 
 	// will create the main curse window by calling the default constructor of Window
 	// This should not be a static member if we want the mainWindow to be deleted in the 
@@ -192,7 +601,7 @@ Represents a CDK screen
 There can be multiple CDK screen in an application. Each CDK screen is associated
 with an ncurses window.
 ******************************************************************************/
-class CdkScreen
+class CdkScreen : public FrameSource
 {
 public:
 
@@ -203,6 +612,7 @@ public:
 		assert(pCppCurseWin->getPtr() != nullptr);
 		pObj = initCDKScreen(pCppCurseWin->getPtr());
 		initCDKColor();
+		CdkApp::getCdkApp()->getFrameScheduler().attach(this);
 
 	}
 	/// Contructor - Create a CDKScreen using a curses window defined by the parameters
@@ -214,6 +624,7 @@ public:
 		assert(pCppCurseWin->getPtr() != nullptr);
 		pObj = initCDKScreen(pCppCurseWin->getPtr());
 		initCDKColor();
+		CdkApp::getCdkApp()->getFrameScheduler().attach(this);
 	}
 		
 
@@ -222,6 +633,8 @@ public:
 	/// curse window (we do not want to delete the main window)
 	~CdkScreen()
 		{
+			CdkApp::getCdkApp()->getFrameScheduler().detach(this);
+			CdkApp::getCdkApp()->getFrameScheduler().cancelCosmetic(this);
 		   	destroyCDKScreen(pObj);
 			if(pCppCurseWin->getPtr() != CdkApp::getCdkApp()->getMainWindow().getPtr())
 			{
@@ -231,12 +644,30 @@ public:
 		}
 
 	/// Erase all widgets associated with the screen without destroying them
-	void erase()
-		{ eraseCDKScreen(pObj); }
+	void erase();
+
+	/// Refresh widgets associated to the screen. All the registered widgets are
+	/// redrawn, so any pending dirty widget is cleared as well.
+	void refresh();
+
+	/// Request the display of the widgets which have been marked dirty since the
+	/// last commit. They are sent to the terminal with the next frame.
+	void commit();
 
-	/// Refresh widgets associated to the screen
-	void refresh()
-		{ refreshCDKScreen(pObj); }
+	/// Redraw the dirty widgets and stage the screen window for the frame
+	void compose() override;
+
+	/// Record that a widget needs to be redrawn at the next commit
+	void invalidate(CdkWidget * pWidget);
+
+	/// Remove a widget from the list of widgets waiting for a redraw
+	void forget(CdkWidget * pWidget);
+
+	/// Add a widget which is not a CDK object (drawn directly with curses) so
+	/// that it is erased and refreshed with the screen
+	void attachWidget(CdkWidget * pWidget);
+	/// Remove a widget added with attachWidget
+	void detachWidget(CdkWidget * pWidget);
 	
 	/// Draw a box around the window
 	void box()
@@ -307,12 +738,21 @@ public:
 	/// Return a pointer to the CDK object
 	CDKSCREEN * getPtr() { return pObj;}
 
+	/// Return the arena owning the buffers of the widgets of the screen
+	ScreenArena & getArena() { return arena;}
+
 	
 private:
 	/// Pointer to the CDK object which is a a screen here
 	CDKSCREEN * pObj;
 	/// Pointer to the underlying encapsulated curses window
 	Window * pCppCurseWin;
+	/// Widgets which have been modified since the last commit
+	std::vector<CdkWidget *> dirtyWidgets{};
+	/// Memory of the buffers given to CDK by the widgets of the screen
+	ScreenArena arena{};
+	/// Widgets of the screen which are not known by CDK
+	std::vector<CdkWidget *> cursesWidgets{};
 	/// Label creating the title
 	std::unique_ptr<CdkLabel> titleWidget{} ;
 
@@ -326,8 +766,14 @@ public:
 	/// Default constructor
 	CdkWidget(){} ;
 
-	/// Destructor
-	virtual ~CdkWidget(){} ;
+	/// Destructor. A widget destroyed before the next commit must not be
+	/// redrawn by the screen
+	virtual ~CdkWidget()
+	{
+		if (dirty && screenPtr != nullptr)
+			screenPtr->forget(this);
+		CdkApp::releaseFocus(this);
+	}
 
 	/// Clear the widget
 	virtual void clear(){};
@@ -336,8 +782,46 @@ public:
 	/// may return a different value.
 	virtual  EExitType activate(chtype * actions = nullptr) = 0;
 
-	/// Draw the widget
-	virtual void draw(bool box = true) = 0;
+	/// Process a single key without blocking. Returns vEARLY_EXIT while the
+	/// widget is still active, otherwise the way the widget has been exited
+	virtual EExitType inject(chtype key) = 0;
+
+	/// Process a text pasted by the user. By default its characters are
+	/// injected one by one until the widget is exited
+	virtual EExitType paste(const std::string & text);
+
+	/// Draw the widget. The widget is marked dirty and the screen commits
+	/// all its dirty widgets
+	virtual void draw(bool box = true)
+	{
+		boxed = box;
+		invalidate();
+		if (screenPtr != nullptr)
+			screenPtr->commit();
+	}
+
+	/// Mark the widget as needing a redraw at the next commit of its screen
+	void invalidate()
+	{
+		if (!dirty && screenPtr != nullptr)
+		{
+			dirty = true;
+			screenPtr->invalidate(this);
+		}
+	}
+
+	/// Return true if the widget has been modified since the last commit
+	bool isDirty() const
+	{
+		return dirty;
+	}
+
+	/// Output sent to the terminal by the redraws of the widget. It is only
+	/// counted when the output accounting of CdkApp is per widget
+	const OutputCounters & getOutputCounters() const
+	{
+		return outputCounters;
+	}
 	/// Erase the widget from the screen without destroying it
 	
 	virtual void erase() = 0;
@@ -370,9 +854,26 @@ public:
 	{
 		fn2 = desiredFn;
 	}
+	/// Register a typed call back. It takes precedence over the other call backs
+	void registerCallback(KeyCallback desiredFn)
+	{
+		keyFn = desiredFn;
+	}
 
 protected:
 	
+	/// Perform the actual drawing through the CDK library. This is called by the
+	/// screen when it commits the dirty widgets
+	virtual void render(bool box) = 0;
+
+	/// True when render() sends the widget to the terminal itself. The draw
+	/// functions of CDK end with a wrefresh of the widget window, which the
+	/// frame scheduler cannot defer
+	virtual bool flushesOnRender() const
+	{
+		return true;
+	}
+
 	/// Preprocessing. Override these functions in the 
 	// derived class for the desired functionality
 	virtual int preProcess(chtype input)
@@ -382,48 +883,221 @@ protected:
 	
 	/// Postprocessing. Override these functions in the 
 	/// derived class for the desired functionality.
+	/// By default, this function calls the registered call back, if any, then
+	/// the widgetCallback of the screen
 	virtual int  postProcess(chtype input)
 	{
-		if (fn != nullptr)
-			return fn(input);
-		return 1;
+		int result = 1;
+		if (keyFn)
+			result = keyFn(*this, input);
+		else if (fn != nullptr)
+			result = fn(input);
+		else if (fn2 != nullptr)
+			result = (screenPtr->*fn2)(input);
+		if (screenPtr->widgetCallback(this, input) == 0)
+			result = 0;
+		return result;
+	}
+
+	/// Install the functions called by CDK before and after each key. The
+	/// clientData given to CDK must be the one returned by clientData()
+	virtual void setHandlers(PROCESSFN pre, PROCESSFN post) = 0;
+
+	/// Value given to CDK as clientData of the handlers. The handlers convert
+	/// it back to the widget without looking it up.
+	void * clientData()
+	{
+		return static_cast<CdkWidget *>(this);
+	}
+
+	/// Return the widget from the clientData of a handler
+	static CdkWidget * fromClientData(void * clientData)
+	{
+		return static_cast<CdkWidget *>(clientData);
 	}
 
 	/// Dispatch function to forward the preProcesssing to the
 	/// class routine. The concept is based on having clientData be 
 	/// a pointer to the object 
-	static	int preHandler (EObjectType cdktype GCC_UNUSED, void *object ,
-		       void *clientData GCC_UNUSED, chtype input )
+	static	int preHandler (EObjectType cdktype GCC_UNUSED, void *object GCC_UNUSED,
+		       void *clientData, chtype input )
 	{
-		auto cdkWidget = CdkApp::getWidget(object);
-		return cdkWidget->preProcess(input);
+		return fromClientData(clientData)->preProcess(input);
 	}
 
 	/// Dispatch function to forward the post Processsing to the
 	/// class routine. The concept is based on having clientData be 
 	/// a pointer to the object 
-	static	int postHandler (EObjectType cdktype GCC_UNUSED, void *object ,
-		       void *clientData GCC_UNUSED, chtype input )
+	static	int postHandler (EObjectType cdktype GCC_UNUSED, void *object GCC_UNUSED,
+		       void *clientData, chtype input )
 	{
-		auto cdkWidget = CdkApp::getWidget(object);
-		return cdkWidget->postProcess(input);
+		return fromClientData(clientData)->postProcess(input);
 	}
 
 	/// Pointer to the screen object to which this widget belongs. The knowledge of 
 	/// the screen allows to convert between terminal coordinates and screen coordinates
 	CdkScreen * screenPtr = nullptr;
 	EObjectType objType;
+	/// Box flag used when the widget is redrawn by the screen
+	bool boxed = true;
 	
 
 private:
+	friend class CdkScreen;
+	/// True when the widget is waiting to be redrawn by its screen
+	bool dirty = false;
+	/// Output of the redraws of the widget
+	OutputCounters outputCounters{};
 	/// Pointer to a call back function
 	
 	CallBack fn = nullptr;
 	CallBack2 fn2 = nullptr;
+	KeyCallback keyFn{};
 
 
 };
 
+#ifdef TUI_COROUTINES
+/****************************************************************************//*
+Coroutine support (C++20)
+
+A Flow is a coroutine which interacts with widgets without blocking. Each
+co_await gives the focus to a widget and suspends the flow until the widget is
+exited; the other flows, the timers and the updates keep running in the event
+loop of CdkApp meanwhile:
+
+	tui::Flow login(tui::CdkEntry & user, tui::CdkButtonbox & confirm)
+	{
+		auto name = co_await user.input();
+		if (!name)
+			co_return;
+		auto button = co_await confirm.choose();
+		...
+	}
+
+A suspended flow only costs its coroutine frame. It is started when it is
+called and destroyed when it returns. A flow waiting on a widget which is
+destroyed is destroyed without being resumed.
+******************************************************************************/
+class Flow
+{
+public:
+	struct promise_type
+	{
+		Flow get_return_object() { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		/// There is nobody to report the exception to
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+/// Result of the interaction with a widget
+template <typename T>
+struct WidgetResult
+{
+	/// How the widget was exited
+	EExitType exitType;
+	/// Value of the widget when it was exited
+	T value;
+	/// True if the widget was exited normally (not escaped)
+	explicit operator bool() const
+	{
+		return exitType == vNORMAL;
+	}
+};
+
+/// Owner of a suspended coroutine: the coroutine is destroyed with its owner,
+/// unless it has been released to be resumed
+class SuspendedHandle
+{
+public:
+	explicit SuspendedHandle(std::coroutine_handle<> handle) : handle(handle) {}
+
+	~SuspendedHandle()
+	{
+		if (handle)
+			handle.destroy();
+	}
+
+	SuspendedHandle(const SuspendedHandle &) = delete;
+	SuspendedHandle & operator=(const SuspendedHandle &) = delete;
+
+	/// Give up the ownership of the coroutine
+	std::coroutine_handle<> release()
+	{
+		return std::exchange(handle, nullptr);
+	}
+
+private:
+	std::coroutine_handle<> handle;
+};
+
+/// Awaiter giving the focus to a widget and resuming when the widget is exited.
+/// If the widget is destroyed first, the flow is destroyed with the done
+/// function
+template <typename W, typename T>
+class FocusAwaiter
+{
+public:
+	explicit FocusAwaiter(W & widget) : widget(widget) {}
+
+	bool await_ready() const noexcept
+	{
+		return false;
+	}
+
+	void await_suspend(std::coroutine_handle<> handle)
+	{
+		auto owner = std::make_shared<SuspendedHandle>(handle);
+		CdkApp::getCdkApp()->focus(widget, [this, owner](EExitType type)
+				{
+					exitType = type;
+					owner->release().resume();
+				});
+	}
+
+	WidgetResult<T> await_resume()
+	{
+		return WidgetResult<T>{exitType, T(widget.getValue())};
+	}
+
+private:
+	W & widget;
+	EExitType exitType = vNEVER_ACTIVATED;
+};
+
+/// Awaiter suspending a flow for some time
+class DelayAwaiter
+{
+public:
+	explicit DelayAwaiter(std::chrono::nanoseconds delay) : delay(delay) {}
+
+	bool await_ready() const noexcept
+	{
+		return delay.count() <= 0;
+	}
+
+	void await_suspend(std::coroutine_handle<> handle)
+	{
+		CdkApp::getCdkApp()->getEventLoop().addTimer(delay, std::chrono::nanoseconds(0),
+				[handle](){ handle.resume(); });
+	}
+
+	void await_resume() {}
+
+private:
+	std::chrono::nanoseconds delay;
+};
+
+/// Suspend the flow for the given time: co_await tui::delay(std::chrono::seconds(1))
+inline DelayAwaiter delay(std::chrono::nanoseconds duration)
+{
+	return DelayAwaiter(duration);
+}
+#endif
+
 /******************************************************************************
 class CdkEntry
 Representation of a widget which accepts user inputs
@@ -448,8 +1122,7 @@ public:
 		   displayType, fieldwidth, minLength, maxLength, true, false);
 		if (pObj != nullptr)
 		{
-			setCDKEntryPreProcess(pObj, CdkWidget::preHandler, this);
-			setCDKEntryPostProcess(pObj, CdkWidget::postHandler, this);
+			setHandlers(CdkWidget::preHandler, CdkWidget::postHandler);
 			screenPtr = &screen;
 			CdkApp::addObject(pObj, this);
 		}
@@ -460,15 +1133,21 @@ public:
 	/// screen if if it not already drawn.
 	EExitType activate(chtype * actions = nullptr) override
 		{activateCDKEntry(pObj, actions); return pObj->exitType;}
+
+	/// Process a single key. This is the non blocking version of activate
+	EExitType inject(chtype key) override
+		{injectCDKEntry(pObj, key); return pObj->exitType;}
+
+#ifdef TUI_COROUTINES
+	/// Awaitable version of activate: co_await entry.input() gives the text typed
+	FocusAwaiter<CdkEntry, std::string> input()
+		{return FocusAwaiter<CdkEntry, std::string>(*this);}
+#endif
  
 	/// Clear the entry field of the widget
 	void clear() override
    		{cleanCDKEntry(pObj);}
 
-	/// Draw the widget. This does not give the focus to the object
-	void draw(bool box = true) override
-		{drawCDKEntry(pObj, box);}
-
 	/// Erase from the screen without destroying it
 	void erase() override
 		{ eraseCDKEntry(pObj);}
@@ -477,9 +1156,33 @@ public:
 	char * getValue() const
 		{return getCDKEntryValue(pObj);}
 
+	/// Complete the value with the words of an index: Tab extends the value
+	/// to the longest prefix shared by the words starting with it, instead of
+	/// exiting the entry. The index must outlive the entry; nullptr removes it
+	void setCompletion(const CompletionIndex * index)
+		{completion = index;}
+
+	/// The first k words of the completion index starting with the value
+	std::vector<std::string> getCompletions(std::size_t k) const;
+
+	/// Restrict the value to the texts accepted by a validator. A key making
+	/// the value an invalid prefix is refused, and Enter is refused while the
+	/// value is not valid. Typing at the end of the value costs a single
+	/// transition of the automaton
+	void setValidator(Validator desired);
+
+	/// Insert the whole text at the cursor as a single edit, drawn once. The
+	/// characters refused by the display type and the control characters are
+	/// dropped, and the text is truncated to the maximum length. The post
+	/// processing is called once with CdkApp::keyPasteEnd
+	EExitType paste(const std::string & text) override;
+
 	/// Move the widget to an absolute or relative position
 	void move(int xpos, int ypos, bool relative = false, bool refresh = false) override
-		{moveCDKEntry(pObj, xpos, ypos, relative, refresh);}
+		{
+			moveCDKEntry(pObj, xpos, ypos, relative, refresh);
+			invalidate();
+		}
 
 	/// Raise this object
 	void raise() override
@@ -508,24 +1211,32 @@ public:
 	
 protected:
 
-	/// Preprocessing. Override this function in the 
-	// derived class for the desired functionality
-	// By default, this function just return 1
-	//int preProcess(chtype input) override {return CdkWidget::postProcess(input);}
-	
-	/// Postprocessing. Override this function in the 
-	/// derived class for the desired functionality.
-	/// By default, this function call the callback fn if it
-	/// has been registered
-	int postProcess(chtype input) override 
+	/// Draw the widget through CDK. This does not give the focus to the object
+	void render(bool box) override
+		{drawCDKEntry(pObj, box);}
+
+	/// Install the functions called by CDK before and after each key
+	void setHandlers(PROCESSFN pre, PROCESSFN post) override
 	{
-		return screenPtr->widgetCallback(this, input);	
-		//	return CdkWidget::postProcess(input);
+		setCDKEntryPreProcess(pObj, pre, clientData());
+		setCDKEntryPostProcess(pObj, post, clientData());
 	}
 
+	/// Validation of the keys, and Tab used for the completion when an index
+	/// is set
+	int preProcess(chtype input) override;
 
 private:
+	/// State of the validator after the first length characters of the value
+	Validator::State validatedState(const char * value, std::size_t length);
+
 	CDKENTRY * pObj = nullptr;
+	const CompletionIndex * completion = nullptr;
+	Validator validator{};
+	/// Last value checked by the validator, and the state after each of its
+	/// characters, so that only the characters which changed are checked again
+	std::string validated{};
+	std::vector<Validator::State> states{};
 
 };
 
@@ -555,8 +1266,7 @@ public:
 		assert(pObj != nullptr);
 		if (pObj != nullptr)
 		{
-			setCDKMenuPreProcess(pObj, CdkWidget::preHandler, this);
-			setCDKMenuPostProcess(pObj, CdkWidget::postHandler, this);
+			setHandlers(CdkWidget::preHandler, CdkWidget::postHandler);
 			screenPtr = &screen;
 			// Add the object to the map of CdkObj *
 			CdkApp::addObject(pObj, this);
@@ -568,15 +1278,21 @@ public:
 	/// screen if if it not already drawn.
 	EExitType activate(chtype * actions = nullptr) override
 		{activateCDKMenu(pObj, actions); return pObj->exitType;}
+
+	/// Process a single key. This is the non blocking version of activate
+	EExitType inject(chtype key) override
+		{injectCDKMenu(pObj, key); return pObj->exitType;}
+
+#ifdef TUI_COROUTINES
+	/// Awaitable version of activate: co_await gives the menu and sub menu items selected
+	FocusAwaiter<CdkMenu, std::pair<int,int>> choose()
+		{return FocusAwaiter<CdkMenu, std::pair<int,int>>(*this);}
+#endif
  
 	/// Clear the entry field of the widget
 	void clear() override
    		{}
 
-	/// Draw the widget. This does not give the focus to the object
-	void draw(bool box = true) override
-		{drawCDKMenu(pObj, box);}
-
 	/// Erase from the screen without destroying it
 	void erase() override
 		{ eraseCDKMenu(pObj);}
@@ -593,6 +1309,7 @@ public:
 	void move(int xpos, int ypos, bool relative = false, bool refresh = false) override
 		{
 			moveCDKLabel(pObj, xpos, ypos, relative, refresh);
+			invalidate();
 		}
 
 	/// Raise this object
@@ -621,20 +1338,15 @@ public:
 	
 protected:
 
+	/// Draw the widget through CDK. This does not give the focus to the object
+	void render(bool box) override
+		{drawCDKMenu(pObj, box);}
 
-	/// Preprocessing. Override this function in the 
-	// derived class for the desired functionality
-	// By default, this function just return 1
-	//int preProcess(chtype input) override {return CdkWidget::postProcess(input);}
-	
-	/// Postprocessing. Override this function in the 
-	/// derived class for the desired functionality.
-	/// By default, this function call the callback fn if it
-	/// has been registered
-	int postProcess(chtype input) override 
+	/// Install the functions called by CDK before and after each key
+	void setHandlers(PROCESSFN pre, PROCESSFN post) override
 	{
-		return screenPtr->widgetCallback(this, input);
-		//return CdkWidget::postProcess(input);
+		setCDKMenuPreProcess(pObj, pre, clientData());
+		setCDKMenuPostProcess(pObj, post, clientData());
 	}
 
 private:
@@ -667,19 +1379,18 @@ public:
 	{
 		auto xpos = xrel + screen.x();
 		auto ypos = yrel + screen.y();
-		auto convert = ConvertToArrayCharPtr(str);
-		pObj = newCDKLabel(screen.getPtr(), xpos, ypos, convert.getPtr(), convert.size(),box, shadow);
+		text.assign(str);
+		pObj = newCDKLabel(screen.getPtr(), xpos, ypos, text.getPtr(), text.size(),box, shadow);
 		assert(pObj != nullptr);
 		if (pObj != nullptr)
 		{
 			// A label is read-only and does not process the input
-			//setCDKLabelPreProcess(pObj, CdkWidget::preHandler, this);
-			//setCDKLabelPostProcess(pObj, CdkWidget::postHandler, this);
 			screenPtr = &screen;
 			// Add the object to the map of CdkObj *
 			CdkApp::addObject(pObj, this);
 		}
 		objType = vLABEL;
+		boxed = box;
 
 	}	
 
@@ -687,15 +1398,15 @@ public:
 	/// screen if if it not already drawn.
 	EExitType activate(chtype * actions = nullptr) override
 		{activateCDKLabel(pObj, actions); return vNORMAL;}
+
+	/// A label does not process the keys, it is exited immediately
+	EExitType inject(chtype) override
+		{return vNORMAL;}
  
 	/// Clear the entry field of the widget
 	void clear() override
    		{}
 
-	/// Draw the widget. This does not give the focus to the object
-	void draw(bool box = true) override
-		{drawCDKLabel(pObj, box);}
-
 	/// Erase from the screen without destroying it
 	void erase() override
 		{ eraseCDKLabel(pObj);}
@@ -703,8 +1414,9 @@ public:
 	/// Set the text value of the label
 	void setValue(const std::string & mesg)
 		{
-			ConvertToArrayCharPtr convert (mesg);
-			setCDKLabel(pObj, convert.getPtr(), convert.size(), false);
+			text.assign(mesg);
+			setCDKLabel(pObj, text.getPtr(), text.size(), false);
+			invalidate();
 		}
 
 	/// Get the current value from the widget
@@ -718,7 +1430,10 @@ public:
 
 	/// Move the widget to an absolute or relative position
 	void move(int xpos, int ypos, bool relative = false, bool refresh = false) override
-		{moveCDKLabel(pObj, xpos, ypos, relative, refresh);}
+		{
+			moveCDKLabel(pObj, xpos, ypos, relative, refresh);
+			invalidate();
+		}
 
 	/// Raise this object
 	void raise() override
@@ -752,24 +1467,19 @@ public:
 	
 protected:
 
+	/// Draw the widget through CDK. This does not give the focus to the object
+	void render(bool box) override
+		{drawCDKLabel(pObj, box);}
 
-	/// Preprocessing. Override this function in the 
-	// derived class for the desired functionality
-	// By default, this function just return 1
-	//int preProcess(chtype input) override {return CdkWidget::postProcess(input);}
-	
-	/// Postprocessing. Override this function in the 
-	/// derived class for the desired functionality.
-	/// By default, this function call the callback fn if it
-	/// has been registered
-	int postProcess(chtype input) override 
+	/// A label is read-only and does not process the input
+	void setHandlers(PROCESSFN, PROCESSFN) override
 	{
-		return screenPtr->widgetCallback(this, input);
-		//return CdkWidget::postProcess(input);
 	}
 
 private:
 	CDKLABEL * pObj = nullptr;
+	/// Conversion buffer of the message, reused by each setValue
+	ConvertToArrayCharPtr text{};
 
 };
 
@@ -800,14 +1510,8 @@ public:
 			bool shadow = false
 			)
 	{
-		// Converts the radio list in an array of const char *
-		char ** list = new  char *[radioList.size()];
-		auto tmp = list;
-		for(auto &item : radioList)
-		{
-			*tmp = const_cast<char *>(item.c_str());
-			++tmp;
-		}
+		// Converts the radio list in an array of const char *. The array belongs to the screen
+		char ** list = screen.getArena().pointerList(radioList);
 		// We create the object
 		auto xpos = xrel + screen.x();
 		auto ypos = yrel + screen.y();
@@ -816,13 +1520,16 @@ public:
 		assert(pObj != nullptr);
 		if (pObj != nullptr)
 		{
-			setCDKRadioPreProcess(pObj, CdkWidget::preHandler, this);
-			setCDKRadioPostProcess(pObj, CdkWidget::postHandler, this);
+			setHandlers(CdkWidget::preHandler, CdkWidget::postHandler);
+			// CDK draws all the rows of the list when it scrolls: curses finds
+			// the rows which have only moved and scrolls the terminal
+			idlok(pObj->win, has_il());
 			screenPtr = &screen;
 			// Add the object to the map of CdkObj *
 			CdkApp::addObject(pObj, this);
 		}
 		objType = vRADIO;
+		boxed = box;
 
 	}	
 
@@ -830,15 +1537,21 @@ public:
 	/// screen if if it not already drawn.
 	EExitType activate(chtype * actions = nullptr) override
 		{activateCDKRadio(pObj, actions); return pObj->exitType;}
+
+	/// Process a single key. This is the non blocking version of activate
+	EExitType inject(chtype key) override
+		{injectCDKRadio(pObj, key); return pObj->exitType;}
+
+#ifdef TUI_COROUTINES
+	/// Awaitable version of activate: co_await gives the index of the selected item
+	FocusAwaiter<CdkRadio, int> choose()
+		{return FocusAwaiter<CdkRadio, int>(*this);}
+#endif
  
 	/// Clear the entry field of the widget
 	void clear() override
    		{}
 
-	/// Draw the widget. This does not give the focus to the object
-	void draw(bool box = true) override
-		{drawCDKRadio(pObj, box);}
-
 	/// Erase from the screen without destroying it
 	void erase() override
 		{ eraseCDKRadio(pObj);}
@@ -855,12 +1568,16 @@ public:
 	void setValue(int option)
 	{
 		setCDKRadioSelectedItem(pObj, option);
+		invalidate();
 
 	}
 
 	/// Move the widget to an absolute or relative position
 	void move(int xpos, int ypos, bool relative = false, bool refresh = false) override
-		{moveCDKRadio(pObj, xpos, ypos, relative, refresh);}
+		{
+			moveCDKRadio(pObj, xpos, ypos, relative, refresh);
+			invalidate();
+		}
 
 	/// Raise this object
 	void raise() override
@@ -888,20 +1605,15 @@ public:
 	
 protected:
 
+	/// Draw the widget through CDK. This does not give the focus to the object
+	void render(bool box) override
+		{drawCDKRadio(pObj, box);}
 
-	/// Preprocessing. Override this function in the 
-	// derived class for the desired functionality
-	// By default, this function just return 1
-	//int preProcess(chtype input) override {return CdkWidget::postProcess(input);}
-	
-	/// Postprocessing. Override this function in the 
-	/// derived class for the desired functionality.
-	/// By default, this function call the callback fn if it
-	/// has been registered
-	int postProcess(chtype input) override 
+	/// Install the functions called by CDK before and after each key
+	void setHandlers(PROCESSFN pre, PROCESSFN post) override
 	{
-		return screenPtr->widgetCallback(this, input);	
-		//return CdkWidget::postProcess(input);
+		setCDKRadioPreProcess(pObj, pre, clientData());
+		setCDKRadioPostProcess(pObj, post, clientData());
 	}
 
 private:
@@ -945,13 +1657,13 @@ public:
 		assert(pObj != nullptr);
 		if (pObj != nullptr)
 		{
-			setCDKFSliderPreProcess(pObj, CdkWidget::preHandler, this);
-			setCDKFSliderPostProcess(pObj, CdkWidget::postHandler, this);
+			setHandlers(CdkWidget::preHandler, CdkWidget::postHandler);
 			screenPtr = &screen;
 			// Add the object to the map of CdkObj *
 			CdkApp::addObject(pObj, this);
 		}
 		objType = vFSLIDER;
+		boxed = box;
 
 	}	
 
@@ -959,16 +1671,22 @@ public:
 	/// screen if if it not already drawn.
 	EExitType activate(chtype * actions = nullptr) override
 		{activateCDKFSlider(pObj, actions); return pObj->exitType;}
+
+	/// Process a single key. This is the non blocking version of activate
+	EExitType inject(chtype key) override
+		{injectCDKFSlider(pObj, key); return pObj->exitType;}
+
+#ifdef TUI_COROUTINES
+	/// Awaitable version of activate: co_await gives the value selected
+	FocusAwaiter<CdkFSlider, float> input()
+		{return FocusAwaiter<CdkFSlider, float>(*this);}
+#endif
  
 	/// Clear the entry field of the widget
 	void clear() override
    		{
 		}
 
-	/// Draw the widget. This does not give the focus to the object
-	void draw(bool box = true) override
-		{drawCDKFSlider(pObj, box);}
-
 	/// Erase from the screen without destroying it
 	void erase() override
 		{ eraseCDKFSlider(pObj);}
@@ -982,14 +1700,35 @@ public:
 		}
 
 	/// Set the current value of the object
-	void setValue(float val)
+	void setValue(float val);
+
+	/// Coalesce the updates of the value, for values updated much faster than
+	/// the frame rate. The latest value is kept, but the widget is only
+	/// redrawn when the bar or the digits displayed would change, and at most
+	/// once per frame
+	void setCoalescing(bool enable)
 	{
-		setCDKFSliderValue(pObj, val);
+		coalescing = enable;
+		pendingUpdates = 0;
+		drawnDisplay = displayOf(getCDKFSliderValue(pObj));
 	}
 
+	/// Number of values given to setValue in coalescing mode which were not
+	/// drawn, either because the display did not change or because a newer
+	/// value came before the next frame
+	std::uint64_t getDroppedUpdates() const
+		{return dropped;}
+
+	/// Number of redraws caused by setValue in coalescing mode
+	std::uint64_t getDrawnUpdates() const
+		{return drawn;}
+
 	/// Move the widget to an absolute or relative position
 	void move(int xpos, int ypos, bool relative = false, bool refresh = false) override
-		{moveCDKFSlider(pObj, xpos, ypos, relative, refresh);}
+		{
+			moveCDKFSlider(pObj, xpos, ypos, relative, refresh);
+			invalidate();
+		}
 
 	/// Raise this object
 	void raise() override
@@ -1007,6 +1746,7 @@ public:
 	void setLowHigh(float min, float max)
 	{
 		setCDKFSliderLowHigh(pObj, min, max );
+		invalidate();
 	}
 
 	/// Return a pointer to the underlying CDK Object (	CDKFSLIDER *)
@@ -1024,24 +1764,41 @@ public:
 	
 protected:
 
+	/// Draw the widget through CDK. This does not give the focus to the object
+	void render(bool box) override;
 
-	/// Preprocessing. Override this function in the 
-	// derived class for the desired functionality
-	// By default, this function just return 1
-	//int preProcess(chtype input) override {return CdkWidget::postProcess(input);}
-	
-	/// Postprocessing. Override this function in the 
-	/// derived class for the desired functionality.
-	/// By default, this function call the callback fn if it
-	/// has been registered
-	int postProcess(chtype input) override 
+	/// Install the functions called by CDK before and after each key
+	void setHandlers(PROCESSFN pre, PROCESSFN post) override
 	{
-		return screenPtr->widgetCallback(this, input);
-		//return CdkWidget::postProcess(input);
+		setCDKFSliderPreProcess(pObj, pre, clientData());
+		setCDKFSliderPostProcess(pObj, post, clientData());
 	}
 
 private:
+	/// What CDK displays for a value: the length of the bar and the value
+	/// rounded to the digits displayed
+	struct Display
+	{
+		int bar;
+		long long digits;
+
+		bool operator==(const Display & other) const
+		{
+			return bar == other.bar && digits == other.digits;
+		}
+	};
+
+	/// Display of a value with the current limits and field width
+	Display displayOf(float value) const;
+
 	CDKFSLIDER * pObj = nullptr;
+	bool coalescing = false;
+	/// Display of the value drawn last
+	Display drawnDisplay{};
+	/// Values given since the last draw which change the display
+	std::uint64_t pendingUpdates = 0;
+	std::uint64_t dropped = 0;
+	std::uint64_t drawn = 0;
 
 
 };
@@ -1072,14 +1829,8 @@ public:
 		// We create the object
 		auto xpos = xrel + screen.x();
 		auto ypos = yrel + screen.y();
-		// Converts the collection of buttons to the desired type
-		char ** list = new  char *[buttons.size()];
-		auto tmp = list;
-		for(auto &item : buttons)
-		{
-			*tmp = const_cast<char *>(item.c_str());
-			++tmp;
-		}
+		// Converts the collection of buttons to the desired type. The array belongs to the screen
+		char ** list = screen.getArena().pointerList(buttons);
 
 		pObj = newCDKButtonbox(screen.getPtr(),
 			   	xpos, ypos,
@@ -1094,13 +1845,13 @@ public:
 		assert(pObj != nullptr);
 		if (pObj != nullptr)
 		{
-			setCDKButtonboxPreProcess(pObj, CdkWidget::preHandler, this);
-			setCDKButtonboxPostProcess(pObj, CdkWidget::postHandler, this);
+			setHandlers(CdkWidget::preHandler, CdkWidget::postHandler);
 			screenPtr = &screen;
 			// Add the object to the map of CdkObj *
 			CdkApp::addObject(pObj, this);
 		}
 		objType = vBUTTONBOX;
+		boxed = box;
 
 	}	
 
@@ -1108,19 +1859,22 @@ public:
 	/// screen if if it not already drawn.
 	EExitType activate(chtype * actions = nullptr) override
 		{activateCDKButtonbox(pObj, actions); return pObj->exitType;}
+
+	/// Process a single key. This is the non blocking version of activate
+	EExitType inject(chtype key) override
+		{injectCDKButtonbox(pObj, key); return pObj->exitType;}
+
+#ifdef TUI_COROUTINES
+	/// Awaitable version of activate: co_await gives the index of the button selected
+	FocusAwaiter<CdkButtonbox, int> choose()
+		{return FocusAwaiter<CdkButtonbox, int>(*this);}
+#endif
  
 	/// Clear the entry field of the widget
 	void clear() override
    		{
 		}
 
-	/// Draw the widget. This does not give the focus to the object
-	void draw(bool box = true) override
-		{
-			drawCDKButtonbox(pObj, box);
-			drawCDKButtonboxButtons(pObj);
-		}
-
 	/// Erase from the screen without destroying it
 	void erase() override
 		{ 
@@ -1139,11 +1893,15 @@ public:
 	void setValue(int val)
 	{
 		setCDKButtonboxCurrentButton(pObj, val);
+		invalidate();
 	}
 
 	/// Move the widget to an absolute or relative position
 	void move(int xpos, int ypos, bool relative = false, bool refresh = false) override
-		{moveCDKButtonbox(pObj, xpos, ypos, relative, refresh);}
+		{
+			moveCDKButtonbox(pObj, xpos, ypos, relative, refresh);
+			invalidate();
+		}
 
 	/// Raise this object
 	void raise() override
@@ -1172,20 +1930,18 @@ public:
 	
 protected:
 
+	/// Draw the widget through CDK. This does not give the focus to the object
+	void render(bool box) override
+		{
+			drawCDKButtonbox(pObj, box);
+			drawCDKButtonboxButtons(pObj);
+		}
 
-	/// Preprocessing. Override this function in the 
-	// derived class for the desired functionality
-	// By default, this function just return 1
-	//int preProcess(chtype input) override {return CdkWidget::postProcess(input);}
-	
-	/// Postprocessing. Override this function in the 
-	/// derived class for the desired functionality.
-	/// By default, this function call the callback fn if it
-	/// has been registered
-	int postProcess(chtype input) override 
+	/// Install the functions called by CDK before and after each key
+	void setHandlers(PROCESSFN pre, PROCESSFN post) override
 	{
-		return screenPtr->widgetCallback(this, input);
-		//return CdkWidget::postProcess(input);
+		setCDKButtonboxPreProcess(pObj, pre, clientData());
+		setCDKButtonboxPostProcess(pObj, post, clientData());
 	}
 
 private:
@@ -1226,14 +1982,8 @@ public:
 		// We create the object
 		auto xpos = xrel + screen.x();
 		auto ypos = yrel + screen.y();
-		// Converts the collection of selections to the desired type
-		char ** list = new  char *[selectionList.size()];
-		auto tmp = list;
-		for(auto &item : selectionList)
-		{
-			*tmp = const_cast<char *>(item.c_str());
-			++tmp;
-		}
+		// Converts the collection of selections to the desired type. The array belongs to the screen
+		char ** list = screen.getArena().pointerList(selectionList);
 
 		pObj = newCDKSelection(screen.getPtr(),
 			   	xpos, ypos,
@@ -1251,14 +2001,19 @@ public:
 		assert(pObj != nullptr);
 		if (pObj != nullptr)
 		{
-			setCDKButtonboxPreProcess(pObj, CdkWidget::preHandler, this);
-			setCDKButtonboxPostProcess(pObj, CdkWidget::postHandler, this);
+			setHandlers(CdkWidget::preHandler, CdkWidget::postHandler);
+			// CDK draws all the rows of the list when it scrolls: curses finds
+			// the rows which have only moved and scrolls the terminal
+			idlok(pObj->win, has_il());
 			screenPtr = &screen;
 			// Add the object to the map of CdkObj *
 			CdkApp::addObject(pObj, this);
 		}
 		objType = vSELECTION;
-		nbrChoices = selectionList.size();
+		boxed = box;
+		// Any modification of the model is pushed to CDK at the next render
+		model.resize(selectionList.size());
+		model.addListener([this](std::size_t, std::size_t){ invalidate(); });
 
 	}	
 
@@ -1266,18 +2021,22 @@ public:
 	/// screen if if it not already drawn.
 	EExitType activate(chtype * actions = nullptr) override
 		{activateCDKSelection(pObj, actions); return pObj->exitType;}
+
+	/// Process a single key. This is the non blocking version of activate
+	EExitType inject(chtype key) override
+		{injectCDKSelection(pObj, key); return pObj->exitType;}
+
+#ifdef TUI_COROUTINES
+	/// Awaitable version of activate: co_await gives the indexes of the selected items
+	FocusAwaiter<CdkSelection, std::vector<int>> choose()
+		{return FocusAwaiter<CdkSelection, std::vector<int>>(*this);}
+#endif
  
 	/// Clear the entry field of the widget
 	void clear() override
    		{
 		}
 
-	/// Draw the widget. This does not give the focus to the object
-	void draw(bool box = true) override
-		{
-			drawCDKSelection(pObj, box);
-		}
-
 	/// Erase from the screen without destroying it
 	void erase() override
 		{ 
@@ -1287,34 +2046,42 @@ public:
 
 	/// Return a vector indicating all indexes of the list
 	/// which have been selected. If nothing is selected, the
-	/// vector is empty 
+	/// vector is empty. Only the selected items are visited.
 	std::vector<int>  getValue() const
 		{
 			std::vector<int> selected{};
-
-			auto res  = getCDKSelectionChoices(pObj);
-			// res is a pointer to an array of integer indicating 
-			// the selection status of each choices
-			for(int index = 0; index < nbrChoices; ++index)
-			{
-				if(*(res + index))
-					selected.push_back(index);
-			}
+			selected.reserve(model.count());
+			model.forEachSelected([&selected](std::size_t index){ selected.push_back(index); });
 			return selected;
 		}
 
 	/// Set the current value of the object. The length of the 
 	/// vector is the same as the number of selectable items. Each element 
 	/// of the vector has a value zero or one.
-	void setValue(std::vector<int> selected)
+	void setValue(const std::vector<int> & selected)
 	{
+		for (std::size_t index = 0; index < selected.size() && index < model.size(); ++index)
+			model.set(index, selected[index] != 0);
+	}
 
-		setCDKSelectionChoices(pObj, selected.data());	
+	/// Return the selection model. The selection can be modified through the
+	/// model (select all, ranges...). Only the items which have changed are
+	/// pushed to CDK, when the widget is drawn.
+	SelectionModel & getModel()
+	{
+		return model;
+	}
+	const SelectionModel & getModel() const
+	{
+		return model;
 	}
 
 	/// Move the widget to an absolute or relative position
 	void move(int xpos, int ypos, bool relative = false, bool refresh = false) override
-		{moveCDKSelection(pObj, xpos, ypos, relative, refresh);}
+		{
+			moveCDKSelection(pObj, xpos, ypos, relative, refresh);
+			invalidate();
+		}
 
 	/// Raise this object
 	void raise() override
@@ -1343,27 +2110,104 @@ public:
 	
 protected:
 
+	/// Draw the widget through CDK. This does not give the focus to the object
+	void render(bool box) override
+		{
+			model.syncChanges([this](std::size_t index, bool value)
+					{ setCDKSelectionChoice(pObj, index, value ? 1 : 0); });
+			drawCDKSelection(pObj, box);
+		}
 
-	/// Preprocessing. Override this function in the 
-	// derived class for the desired functionality
-	// By default, this function just return 1
-	//int preProcess(chtype input) override {return CdkWidget::postProcess(input);}
-	
-	/// Postprocessing. Override this function in the 
-	/// derived class for the desired functionality.
-	/// By default, this function call the callback fn if it
-	/// has been registered
-	int postProcess(chtype input) override 
+	/// Install the functions called by CDK before and after each key
+	void setHandlers(PROCESSFN pre, PROCESSFN post) override
+	{
+		setCDKSelectionPreProcess(pObj, pre, clientData());
+		setCDKSelectionPostProcess(pObj, post, clientData());
+	}
+
+	/// The user may have changed the choice of the current item: the model is
+	/// updated with the state known by CDK
+	int postProcess(chtype input) override
 	{
-		return screenPtr->widgetCallback(this, input);
-		//return CdkWidget::postProcess(input);
+		auto current = getCDKSelectionCurrent(pObj);
+		if (current >= 0 && static_cast<std::size_t>(current) < model.size())
+			model.setSynced(current, getCDKSelectionChoice(pObj, current) != 0);
+		return CdkWidget::postProcess(input);
 	}
 
 private:
 	CDKSELECTION * pObj = nullptr;
-	int nbrChoices {};
+	/// Selection state of the items
+	SelectionModel model{};
+
+
+};
+
+/****************************************************************************//*
+class CdkBound
+Binding of the key handlers of a widget at compile time.
+
+Derived inherits from CdkBound<Derived, Widget> instead of Widget and defines
+public preKey and/or postKey functions. CDK then calls these functions directly
+from the clientData of the widget, without lookup and without virtual call:
 
+	class PortEntry : public CdkBound<PortEntry, CdkEntry>
+	{
+	public:
+		using CdkBound::CdkBound;
+		int preKey(chtype key) { return isdigit(key) || key == KEY_ENTER; }
+	};
+
+The processing of Widget still runs after them (for instance the validation
+of a CdkEntry or the synchronization of a CdkSelection): preKey is called
+first and the key is rejected if it returns 0, postKey is called before the
+postProcess of Widget.
+******************************************************************************/
+template <typename Derived, typename Widget>
+class CdkBound : public Widget
+{
+public:
+	/// Constructors - The arguments are those of Widget
+	template <typename... Args>
+	CdkBound(Args &&... args) : Widget(std::forward<Args>(args)...)
+	{
+		if (this->getCDKObject() != nullptr)
+			this->setHandlers(&CdkBound::boundPre, &CdkBound::boundPost);
+	}
+
+	/// Default preprocessing, hidden by Derived::preKey. It accepts the key
+	int preKey(chtype)
+	{
+		return 1;
+	}
 
+	/// Default postprocessing, hidden by Derived::postKey
+	int postKey(chtype)
+	{
+		return 1;
+	}
+
+private:
+	static int boundPre(EObjectType cdktype GCC_UNUSED, void * object GCC_UNUSED,
+			void * clientData, chtype input)
+	{
+		auto widget = static_cast<Derived *>(CdkWidget::fromClientData(clientData));
+		if (widget->preKey(input) == 0)
+			return 0;
+		return widget->Widget::preProcess(input);
+	}
+
+	static int boundPost(EObjectType cdktype GCC_UNUSED, void * object GCC_UNUSED,
+			void * clientData, chtype input)
+	{
+		auto widget = static_cast<Derived *>(CdkWidget::fromClientData(clientData));
+		auto result = widget->postKey(input);
+		if (widget->Widget::postProcess(input) == 0)
+			result = 0;
+		return result;
+	}
 };
 
 } // end of namespace
+
+#endif
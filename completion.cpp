@@ -0,0 +1,161 @@
+#include "completion.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+namespace
+{
+	/// Header of an index file. The offsets follow, then the blob
+	struct FileHeader
+	{
+		char magic[8];
+		std::uint64_t count;
+		std::uint64_t blobSize;
+	};
+
+	constexpr char fileMagic[8] = {'T', 'U', 'I', 'C', 'O', 'M', 'P', '1'};
+}
+
+tui::CompletionIndex::CompletionIndex(std::vector<std::string> words)
+{
+	std::sort(words.begin(), words.end());
+	words.erase(std::unique(words.begin(), words.end()), words.end());
+	std::size_t total = 0;
+	for (auto & word : words)
+		total += word.size();
+	blobStorage.reserve(total);
+	offsetStorage.reserve(words.size() + 1);
+	for (auto & word : words)
+	{
+		offsetStorage.push_back(blobStorage.size());
+		blobStorage += word;
+	}
+	offsetStorage.push_back(blobStorage.size());
+	count = words.size();
+	offsets = offsetStorage.data();
+	blob = blobStorage.data();
+}
+
+tui::CompletionIndex::CompletionIndex(const std::string & path)
+	: file(new MappedFile(path))
+{
+	FileHeader header{};
+	if (file->size() < sizeof(header))
+		throw std::runtime_error(path + ": not a completion index");
+	std::memcpy(&header, file->data(), sizeof(header));
+	if (std::memcmp(header.magic, fileMagic, sizeof(fileMagic)) != 0)
+		throw std::runtime_error(path + ": not a completion index");
+	// The sizes of the header are checked against the size of the file before
+	// they are used in a computation, which they could make overflow
+	auto available = file->size() - sizeof(header);
+	if (header.count >= available / sizeof(std::uint64_t)
+			|| header.blobSize != available - (header.count + 1) * sizeof(std::uint64_t))
+		throw std::runtime_error(path + ": corrupt completion index");
+	// The header size keeps the offsets aligned in the mapping
+	count = static_cast<std::size_t>(header.count);
+	offsets = reinterpret_cast<const std::uint64_t *>(file->data() + sizeof(header));
+	blob = file->data() + sizeof(header) + (count + 1) * sizeof(std::uint64_t);
+	// The words must lie in the blob: getWord does not check the offsets
+	bool valid = offsets[0] == 0 && offsets[count] == header.blobSize;
+	for (std::size_t n = 0; valid && n < count; ++n)
+		valid = offsets[n] <= offsets[n + 1];
+	if (!valid)
+		throw std::runtime_error(path + ": corrupt completion index");
+}
+
+void tui::CompletionIndex::save(const std::string & path) const
+{
+	auto stream = std::fopen(path.c_str(), "wb");
+	if (stream == nullptr)
+		throw std::system_error(errno, std::generic_category(), path);
+	FileHeader header{};
+	std::memcpy(header.magic, fileMagic, sizeof(fileMagic));
+	header.count = count;
+	header.blobSize = offsets[count];
+	bool ok = std::fwrite(&header, sizeof(header), 1, stream) == 1
+		&& std::fwrite(offsets, sizeof(std::uint64_t), count + 1, stream) == count + 1
+		&& std::fwrite(blob, 1, offsets[count], stream) == offsets[count];
+	auto error = errno;
+	if (std::fclose(stream) != 0 && ok)
+	{
+		error = errno;
+		ok = false;
+	}
+	if (!ok)
+		throw std::system_error(error, std::generic_category(), path);
+}
+
+int tui::CompletionIndex::compare(std::size_t n, const std::string & prefix) const
+{
+	const char * text;
+	std::size_t length;
+	getWord(n, text, length);
+	auto result = std::memcmp(text, prefix.data(), std::min(length, prefix.size()));
+	if (result != 0)
+		return result;
+	// A word shorter than the prefix comes before it
+	return length < prefix.size() ? -1 : 0;
+}
+
+tui::CompletionIndex::Range tui::CompletionIndex::find(const std::string & prefix) const
+{
+	// First word which is not before the prefix
+	std::size_t low = 0;
+	std::size_t high = count;
+	while (low < high)
+	{
+		auto middle = low + (high - low) / 2;
+		if (compare(middle, prefix) < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	// First word after the words starting with the prefix
+	auto first = low;
+	high = count;
+	while (low < high)
+	{
+		auto middle = low + (high - low) / 2;
+		if (compare(middle, prefix) == 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return Range(first, low);
+}
+
+std::string tui::CompletionIndex::commonPrefix(const std::string & prefix) const
+{
+	auto range = find(prefix);
+	if (range.first == range.second)
+		return prefix;
+	// The words are sorted: the prefix shared by all of them is the one of the
+	// first and of the last
+	const char * first;
+	const char * last;
+	std::size_t firstLength;
+	std::size_t lastLength;
+	getWord(range.first, first, firstLength);
+	getWord(range.second - 1, last, lastLength);
+	auto common = std::mismatch(first, first + std::min(firstLength, lastLength), last).first;
+	return std::string(first, common);
+}
+
+std::vector<std::string> tui::CompletionIndex::complete(const std::string & prefix, std::size_t k) const
+{
+	auto range = find(prefix);
+	std::vector<std::string> result;
+	auto last = std::min(range.second, range.first + k);
+	result.reserve(last - range.first);
+	for (auto n = range.first; n < last; ++n)
+	{
+		const char * text;
+		std::size_t length;
+		getWord(n, text, length);
+		result.emplace_back(text, length);
+	}
+	return result;
+}
@@ -0,0 +1,91 @@
+#ifndef TUI_COMPLETION_H
+#define TUI_COMPLETION_H
+
+#include "mapped_file.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace tui
+
+{
+
+/***************************************************************************//*
+Index of the words proposed as completions, such as host names or commands.
+
+The words are sorted and stored one after the other in a single block of
+text, with an array of offsets: the index costs the size of the words plus 8
+bytes per word, and needs no allocation per word. The words starting with a
+prefix form a range of the array, found with two binary searches, so a
+completion costs O(log n) comparisons whatever the size of the dictionary.
+
+The index can be saved to a file and loaded again by mapping the file, without
+reading or sorting the words again.
+
+******************************************************************************/
+class CompletionIndex
+{
+	public:
+		/// Range of the words starting with a prefix
+		using Range = std::pair<std::size_t, std::size_t>;
+
+		/// Build the index of a list of words. The duplicates are removed
+		explicit CompletionIndex(std::vector<std::string> words);
+
+		/// Load an index saved by save(). Throws std::system_error if the
+		/// file cannot be mapped and std::runtime_error if it is not an index
+		/// or if it is corrupt
+		explicit CompletionIndex(const std::string & path);
+
+		CompletionIndex(const CompletionIndex &) = delete;
+		CompletionIndex & operator=(const CompletionIndex &) = delete;
+
+		/// Save the index. Throws std::system_error if the file cannot be written
+		void save(const std::string & path) const;
+
+		/// Number of words
+		std::size_t size() const
+		{
+			return count;
+		}
+
+		/// Get the word n
+		void getWord(std::size_t n, const char *& text, std::size_t & length) const
+		{
+			text = blob + offsets[n];
+			length = static_cast<std::size_t>(offsets[n + 1] - offsets[n]);
+		}
+
+		/// Words starting with a prefix, as a range [first, last)
+		Range find(const std::string & prefix) const;
+
+		/// Longest prefix shared by all the words starting with prefix. It is
+		/// prefix itself if no word starts with it
+		std::string commonPrefix(const std::string & prefix) const;
+
+		/// The first k words starting with prefix, in alphabetical order
+		std::vector<std::string> complete(const std::string & prefix, std::size_t k) const;
+
+	private:
+		/// Compare the start of word n with a prefix, like memcmp
+		int compare(std::size_t n, const std::string & prefix) const;
+
+		std::size_t count = 0;
+		/// Offset of each word in the blob, followed by the size of the blob
+		const std::uint64_t * offsets = nullptr;
+		/// Text of the words, without separators
+		const char * blob = nullptr;
+		/// Storage of an index built in memory
+		std::vector<std::uint64_t> offsetStorage{};
+		std::string blobStorage{};
+		/// Storage of an index loaded from a file
+		std::unique_ptr<MappedFile> file{};
+};
+
+} // end of namespace
+
+#endif
@@ -1,5 +1,23 @@
 #include "curses_support.h"
 #include "mutex"
+#include <algorithm>
+#include <sys/ioctl.h>
+#include <poll.h>
+
+// Frame scheduler shared by all the windows
+tui::FrameScheduler * tui::Window::scheduler = nullptr;
+
+namespace
+{
+	/// First wait between two frames when the terminal becomes congested
+	constexpr std::chrono::milliseconds firstBackoff(50);
+	/// Longest wait between two frames while the terminal is congested
+	constexpr std::chrono::milliseconds maxBackoff(1000);
+	/// The congestion is over when the wait has shrunk below this
+	constexpr std::chrono::milliseconds minBackoff(5);
+	/// A terminal update taking longer than this has waited for the terminal
+	constexpr std::chrono::milliseconds blockedUpdate(10);
+}
 
 // Creates a curses window with the desired characteristics
 tui::Window::Window(int lines, int cols, int begin_y, int begin_x, Window * parent , bool relative )
@@ -31,7 +49,8 @@ tui::Window::Window(int lines, int cols, int begin_y, int begin_x, Window * pare
 // Create the main curses window
 tui::Window::Window()
 {
-	ptr = initscr();
+	ptr = stdscr != nullptr ? stdscr : initscr();
+	readGeometry();
 	// This creates the main 
 	//std::once_flag mainWindowCreated;
 	//std::call_once(mainWindowCreated, [this](){ptr = initscr();});
@@ -40,6 +59,8 @@ tui::Window::Window()
 
 tui::Window::~Window()
 {
+	if (scheduler != nullptr)
+		scheduler->cancelCosmetic(this);
 
 	delwin(ptr);
 
@@ -61,15 +82,28 @@ void tui::Window::move(int y, int x, bool relative)
 
 void tui::Window::update()
 {
-	wrefresh(ptr);
+	wnoutrefresh(ptr);
+	requestFrame();
 }
 
 void tui::Window::box()
 {
+	// The border is cosmetic, it waits while the terminal is congested
+	if (scheduler != nullptr && scheduler->deferCosmetic(this, [this]{ box(); }))
+		return;
 	chtype ls, rs, ts, bs, tl, tr, bl, br;
 	ls = rs = ts = bs = tl = tr = bl = br = 0;
 	wborder(ptr , ls, rs, ts, bs, tl, tr, bl,  br);
-	wrefresh(ptr);
+	wnoutrefresh(ptr);
+	requestFrame();
+}
+
+void tui::Window::requestFrame()
+{
+	if (scheduler != nullptr)
+		scheduler->request();
+	else
+		doupdate();
 }
 
 
@@ -78,3 +112,177 @@ int tui::Window::getchar()
 	return wgetch(ptr);
 }
 
+
+/******************************************************************************
+
+  Frame scheduler
+
+******************************************************************************/
+
+void tui::FrameScheduler::setMaxFrameRate(unsigned fps)
+{
+	maxFps = fps;
+	if (fps != 0)
+		interval = std::chrono::duration_cast<Clock::duration>(std::chrono::seconds(1)) / fps;
+	else
+		interval = Clock::duration::zero();
+	// Going back to the immediate mode must not leave a frame behind
+	if (fps == 0 && pending())
+		produce();
+}
+
+void tui::FrameScheduler::attach(FrameSource * source)
+{
+	sources.push_back(source);
+}
+
+void tui::FrameScheduler::detach(FrameSource * source)
+{
+	sources.erase(std::remove(sources.begin(), sources.end(), source), sources.end());
+}
+
+void tui::FrameScheduler::request()
+{
+	++requests;
+	++requestsInFrame;
+	// A frame requested while a frame is produced is left for the next tick
+	if (maxFps != 0 || producing)
+		return;
+	// While the terminal is congested the frames are produced by tick()
+	if (!isCongested() && !checkOutput())
+		produce();
+	else if (requestsInFrame == 1)
+		++deferredFrames;
+}
+
+bool tui::FrameScheduler::tick()
+{
+	if (!pending() || Clock::now() - lastFrame < frameInterval())
+		return false;
+	if (checkOutput())
+	{
+		// The frame waits again, longer
+		++deferredFrames;
+		lastFrame = Clock::now();
+		return false;
+	}
+	produce();
+	return true;
+}
+
+void tui::FrameScheduler::flush()
+{
+	if (pending())
+		produce();
+}
+
+tui::FrameScheduler::Clock::duration tui::FrameScheduler::timeToNextFrame() const
+{
+	if (!pending())
+		return Clock::duration::max();
+	auto elapsed = Clock::now() - lastFrame;
+	if (elapsed >= frameInterval())
+		return Clock::duration::zero();
+	return frameInterval() - elapsed;
+}
+
+void tui::FrameScheduler::setBackpressure(int fd, std::size_t pending)
+{
+	outputFd = fd;
+	maxPending = pending;
+	backoff = Clock::duration::zero();
+}
+
+bool tui::FrameScheduler::checkOutput()
+{
+	if (outputFd < 0)
+		return false;
+	int queued = 0;
+	bool full = ioctl(outputFd, TIOCOUTQ, &queued) == 0 && static_cast<std::size_t>(queued) > maxPending;
+	// A pseudo terminal always reports an empty queue, it is congested when
+	// it does not accept more bytes
+	if (!full)
+	{
+		pollfd fd{outputFd, POLLOUT, 0};
+		full = poll(&fd, 1, 0) == 0;
+	}
+	if (full)
+		slowDown();
+	return full;
+}
+
+void tui::FrameScheduler::slowDown()
+{
+	if (backoff == Clock::duration::zero())
+		backoff = firstBackoff;
+	else
+		backoff = std::min<Clock::duration>(backoff * 2, maxBackoff);
+}
+
+bool tui::FrameScheduler::deferCosmetic(const void * key, std::function<void()> redraw)
+{
+	if (!isCongested())
+		return false;
+	auto pos = std::find_if(cosmetics.begin(), cosmetics.end(),
+			[key](const std::pair<const void *, std::function<void()>> & cosmetic){ return cosmetic.first == key; });
+	if (pos != cosmetics.end())
+		pos->second = std::move(redraw);
+	else
+		cosmetics.emplace_back(key, std::move(redraw));
+	// The frame produced at the end of the congestion draws it
+	++requestsInFrame;
+	return true;
+}
+
+void tui::FrameScheduler::cancelCosmetic(const void * key)
+{
+	cosmetics.erase(std::remove_if(cosmetics.begin(), cosmetics.end(),
+			[key](const std::pair<const void *, std::function<void()>> & cosmetic){ return cosmetic.first == key; }),
+			cosmetics.end());
+}
+
+void tui::FrameScheduler::produce()
+{
+	producing = true;
+	// The cosmetic redraws deferred during the congestion are part of this frame
+	if (!isCongested() && !cosmetics.empty())
+	{
+		auto redraws = std::move(cosmetics);
+		cosmetics.clear();
+		for (auto & cosmetic : redraws)
+			cosmetic.second();
+	}
+	// Count the requests before composing so that a source requesting a frame
+	// while it is composed does not loop
+	coalesced += requestsInFrame - 1;
+	requestsInFrame = 0;
+	OutputCounters before{};
+	if (meter != nullptr)
+		before = meter->read();
+	for (auto source : sources)
+		source->compose();
+	auto start = Clock::now();
+	if (meter != nullptr)
+		meter->update();
+	else
+		doupdate();
+	lastFrame = Clock::now();
+	if (meter != nullptr)
+		meter->addFrame(meter->read() - before);
+	// A pseudo terminal accepts several frames before its queue is full, the
+	// congestion then shows as an update which blocked
+	if (outputFd >= 0)
+	{
+		if (lastFrame - start > blockedUpdate)
+			slowDown();
+		else if (backoff - backoff / 8 >= minBackoff)
+			backoff -= backoff / 8;
+		else
+			backoff = Clock::duration::zero();
+	}
+	// The next frame draws the cosmetic redraws once the congestion is over
+	if (!isCongested() && !cosmetics.empty())
+		++requestsInFrame;
+	++frames;
+	producing = false;
+}
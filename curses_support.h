@@ -1,16 +1,189 @@
+#ifndef TUI_CURSES_SUPPORT_H
+#define TUI_CURSES_SUPPORT_H
+
+#include "output_meter.h"
 #include <cdk_test.h>
+#include <algorithm>
 #include <cassert>
 #include <string>
 #include <vector>
 #include <utility>
 #include <unordered_map>
 #include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <functional>
 
 
 namespace tui
 
 {
 
+/***************************************************************************//*
+Object contributing to the frames produced by the FrameScheduler.
+
+compose() stages the content of the object with wnoutrefresh. It must not call
+doupdate, this is done once per frame by the scheduler.
+******************************************************************************/
+class FrameSource
+{
+	public:
+		virtual ~FrameSource(){};
+		/// Stage the pending output of the object for the next frame
+		virtual void compose() = 0;
+};
+
+/***************************************************************************//*
+Coalesce the draw requests into frames.
+
+Every draw request marks a frame as pending. With a maximum frame rate of zero
+each request produces a frame immediately (no coalescing). Otherwise the frame
+is produced by tick() once the frame interval has elapsed, so that a burst of
+draw requests results in a single frame.
+
+A frame is a single terminal update only for the output staged with
+wnoutrefresh: the windows, the boxes, the titles and the widgets drawn with
+curses. The draw functions of CDK call wrefresh themselves, so each CDK widget
+redrawn in a frame costs a terminal update of its own (see sourceFlushCount),
+and the echo of the keys injected in a CDK widget is sent immediately, outside
+of the frames.
+
+With the backpressure enabled, the output queue of the terminal is checked
+before each frame. When the terminal is congested (too many bytes waiting in
+the queue, or an update which blocked because the queue was full) the frames
+are spaced by a wait which doubles up to one second each time the terminal is
+found congested again, and which shrinks with each frame sent without
+blocking. The widgets keep only their latest state, so the intermediate values
+are never sent. The cosmetic redraws, such as the borders and the titles, are
+deferred until the congestion is over.
+******************************************************************************/
+class FrameScheduler
+{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		/// Set the maximum number of frames per second. Zero disables the rate
+		/// limitation and each request is displayed immediately.
+		void setMaxFrameRate(unsigned fps);
+		/// Return the maximum number of frames per second (zero if unlimited)
+		unsigned getMaxFrameRate() const
+		{
+			return maxFps;
+		}
+		/// Add an object composed in each frame
+		void attach(FrameSource * source);
+		/// Remove an object from the frames
+		void detach(FrameSource * source);
+		/// Request a frame. Depending on the frame rate the frame is produced now
+		/// or at the next tick
+		void request();
+		/// Produce a frame if one is pending and the frame interval has elapsed.
+		/// Return true if a frame has been produced
+		bool tick();
+		/// Produce the pending frame now, irrespective of the frame rate
+		void flush();
+		/// Return true if a frame is waiting to be produced
+		bool pending() const
+		{
+			return requestsInFrame != 0;
+		}
+		/// Return the time to wait before the pending frame is due. If there is no
+		/// pending frame, Clock::duration::max() is returned
+		Clock::duration timeToNextFrame() const;
+		/// Number of frames sent to the terminal
+		std::uint64_t framesProduced() const
+		{
+			return frames;
+		}
+		/// Number of draw requests received
+		std::uint64_t drawRequests() const
+		{
+			return requests;
+		}
+		/// Number of draw requests which were merged in the frame of another request
+		std::uint64_t requestsCoalesced() const
+		{
+			return coalesced;
+		}
+		/// Record a terminal update done by a source while it was composed,
+		/// outside of the doupdate of the frame
+		void countSourceFlush()
+		{
+			++sourceFlushes;
+		}
+		/// Number of terminal updates done by the sources while they were
+		/// composed. Each one costs the terminal a flush of its own
+		std::uint64_t sourceFlushCount() const
+		{
+			return sourceFlushes;
+		}
+		/// Watch the output queue of the terminal file descriptor fd. The
+		/// terminal is congested when more than maxPending bytes are waiting.
+		/// A negative fd disables the backpressure
+		void setBackpressure(int fd, std::size_t maxPending);
+		/// Return true while the frames are slowed down for the terminal
+		bool isCongested() const
+		{
+			return backoff != Clock::duration::zero();
+		}
+		/// Number of frames which have waited for the terminal
+		std::uint64_t framesDeferred() const
+		{
+			return deferredFrames;
+		}
+		/// Keep a cosmetic redraw for the end of the congestion. Returns false,
+		/// and keeps nothing, if the terminal is not congested. A redraw replaces
+		/// the one deferred before with the same key
+		bool deferCosmetic(const void * key, std::function<void()> redraw);
+		/// Forget the cosmetic redraw deferred with a key
+		void cancelCosmetic(const void * key);
+		/// Select the meter recording the output of each frame, nullptr to stop
+		/// the accounting
+		void setOutputMeter(OutputMeter * pMeter)
+		{
+			meter = pMeter;
+		}
+		/// Return the meter recording the output, nullptr if none
+		OutputMeter * getOutputMeter() const
+		{
+			return meter;
+		}
+	private:
+		/// Compose all the sources and update the terminal
+		void produce();
+		/// Check the output queue of the terminal. Returns true if too many
+		/// bytes are waiting, the terminal is then congested
+		bool checkOutput();
+		/// Slow down the frames after a congestion, more if it goes on
+		void slowDown();
+		/// Minimum time between two frames, longer while the terminal is congested
+		Clock::duration frameInterval() const
+		{
+			return std::max(interval, backoff);
+		}
+
+		std::vector<FrameSource *> sources{};
+		unsigned maxFps = 0;
+		Clock::duration interval{};	//< Minimum time between two frames
+		Clock::time_point lastFrame{};	//< Time at which the last frame was produced
+		std::uint64_t requestsInFrame{};	//< Requests waiting for the next frame
+		std::uint64_t frames{};
+		std::uint64_t requests{};
+		std::uint64_t coalesced{};
+		std::uint64_t sourceFlushes{};
+		OutputMeter * meter = nullptr;
+		/// Terminal whose output queue is watched, -1 if none
+		int outputFd = -1;
+		std::size_t maxPending = 0;
+		/// Wait between two frames while the terminal is congested, zero otherwise
+		Clock::duration backoff{};
+		std::uint64_t deferredFrames{};
+		/// True while a frame is produced
+		bool producing = false;
+		/// Cosmetic redraws waiting for the end of the congestion
+		std::vector<std::pair<const void *, std::function<void()>>> cosmetics{};
+};
+
 
 /***************************************************************************//*
 Representation of a ncurse WINDOW
@@ -23,10 +196,14 @@ class Window
 		/// it is a subWindow. If relative is true, the coordinates for the
 		/// subWindow are relative to those of the parent Window
 		Window(int lines, int cols, int begin_y, int begin_x, Window* parent = nullptr, bool relative = true);
-		/// Create the stdscr curses window
+		/// Create the stdscr curses window. If curses has been started on
+		/// another terminal with newterm, its stdscr is used
 		Window();
 		/// Create a Window object from an existing WINDOW *
-		Window(WINDOW * pWin):ptr(pWin){};
+		Window(WINDOW * pWin):ptr(pWin)
+		{
+			readGeometry();
+		}
 		/// Assign a different WINDOW* to this object. Returns the old pointer
 		WINDOW * assign(WINDOW * newWin)
 			{
@@ -36,6 +213,12 @@ class Window
 			}
 		/// Destrow the Window
 		~Window();
+		/// Select the frame scheduler used to send the Windows to the terminal.
+		/// Without scheduler each update is sent to the terminal immediately
+		static void setFrameScheduler(FrameScheduler * pScheduler)
+			{
+				scheduler = pScheduler;
+			}
 		/// Create a box around the Window
 		void box();
 		/// Move the Window to a different location. If it is a subWindow, it is moved
@@ -49,26 +232,40 @@ class Window
 		WINDOW* getPtr()
 			{return ptr;} 
 		/// Return the x position of the top left corner of the window
-		int x()
+		int x() const
 		{
 			return x_pos;
 		}
 		/// Return the y  position of the top left corner of the window
-		int y()
+		int y() const
 		{
 			return y_pos;
 		}
 		/// Return the width  of the window
-		int w()
+		int w() const
 		{
 			return width;
 		}
 		/// Return the height of the window
-		int h()
+		int h() const
 		{
 			return height;
 		}
 	private:
+		/// Send the staged Windows to the terminal, now or with the next frame
+		static void requestFrame();
+		/// Set the position and the size from the curses window
+		void readGeometry()
+		{
+			if (ptr != nullptr)
+			{
+				getbegyx(ptr, y_pos, x_pos);
+				getmaxyx(ptr, height, width);
+			}
+		}
+
+		/// Frame scheduler shared by all the Windows
+		static FrameScheduler * scheduler;
 		WINDOW * ptr = nullptr;
 		bool subWindow = false;
 		// The following window position and size are relative to the terminal whether this is a
@@ -81,3 +278,5 @@ class Window
 };
 
 } // end of namespace
+
+#endif
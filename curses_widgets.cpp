@@ -0,0 +1,1339 @@
+#include "curses_widgets.h"
+#include <algorithm>
+#include <cstdlib>
+
+/******************************************************************************
+
+  Curses Widget
+
+******************************************************************************/
+
+tui::CursesWidget::CursesWidget(CdkScreen & screen, int xrel, int yrel, int height, int width,
+		const std::string & title, bool box)
+	: window(height, width, yrel + screen.y(), xrel + screen.x()), title(title)
+{
+	assert(window.getPtr() != nullptr);
+	keypad(win(), TRUE);
+	screenPtr = &screen;
+	boxed = box;
+	objType = vNULL;
+	alive = std::make_shared<bool>(true);
+	// curses may then send the scrolls of scrollContent as scrolls of the terminal
+	idlok(win(), has_il());
+	screen.attachWidget(this);
+}
+
+tui::CursesWidget::~CursesWidget()
+{
+	*alive = false;
+	screenPtr->detachWidget(this);
+}
+
+EExitType tui::CursesWidget::activate(chtype * actions)
+{
+	draw(boxed);
+	if (actions != nullptr)
+	{
+		for (; *actions != 0; ++actions)
+		{
+			auto exitType = inject(*actions);
+			if (exitType != vEARLY_EXIT)
+				return exitType;
+		}
+		return vEARLY_EXIT;
+	}
+	for (;;)
+	{
+		// The pending frame is displayed before waiting for the user
+		CdkApp::getCdkApp()->getFrameScheduler().flush();
+		auto key = wgetch(win());
+		if (key == ERR)
+			continue;
+		auto exitType = inject(key);
+		if (exitType != vEARLY_EXIT)
+			return exitType;
+	}
+}
+
+EExitType tui::CursesWidget::inject(chtype key)
+{
+	// As with CDK, a preProcess returning 0 discards the key
+	if (preProcess(key) == 0)
+		return vEARLY_EXIT;
+	auto exitType = processKey(key);
+	if (exitType == vEARLY_EXIT)
+		postProcess(key);
+	draw(boxed);
+	return exitType;
+}
+
+void tui::CursesWidget::erase()
+{
+	werase(win());
+	wnoutrefresh(win());
+	// The widget is drawn entirely the next time it is drawn
+	fullRedraw = true;
+	screenPtr->commit();
+}
+
+void tui::CursesWidget::move(int xpos, int ypos, bool relative, bool refresh)
+{
+	int y{}, x{};
+	getbegyx(win(), y, x);
+	if (relative)
+	{
+		xpos += x;
+		ypos += y;
+	}
+	mvwin(win(), ypos, xpos);
+	invalidateAll();
+	if (refresh)
+		screenPtr->commit();
+}
+
+void tui::CursesWidget::raise()
+{
+	touchwin(win());
+	invalidate();
+}
+
+void tui::CursesWidget::render(bool box)
+{
+	if (box != drawnBox)
+		fullRedraw = true;
+	auto full = fullRedraw;
+	if (full)
+	{
+		werase(win());
+		if (box)
+			::box(win(), 0, 0);
+		if (!title.empty())
+		{
+			auto length = std::min<int>(title.size(), contentCols());
+			mvwaddnstr(win(), contentTop() - 1, contentLeft() + (contentCols() - length) / 2, title.c_str(), length);
+		}
+		drawnBox = box;
+		fullRedraw = false;
+	}
+	renderContent(full);
+	wnoutrefresh(win());
+}
+
+void tui::CursesWidget::drawRow(int row, const char * text, std::size_t length, chtype attribute)
+{
+	auto cols = static_cast<std::size_t>(std::max(contentCols(), 0));
+	length = std::min(length, cols);
+	wattrset(win(), attribute);
+	mvwaddnstr(win(), contentTop() + row, contentLeft(), text, length);
+	if (length < cols)
+		whline(win(), ' ', cols - length);
+	wattrset(win(), A_NORMAL);
+}
+
+void tui::CursesWidget::scrollContent(int lines, int firstRow)
+{
+	auto top = contentTop() + firstRow;
+	auto rows = contentRows() - firstRow;
+	if (lines == 0 || rows <= 0)
+		return;
+	auto bottom = top + rows - 1;
+	// Scrolling is only enabled for the wscrl so that writing in the bottom
+	// right corner never scrolls the window
+	scrollok(win(), TRUE);
+	wsetscrreg(win(), top, bottom);
+	wscrl(win(), lines);
+	scrollok(win(), FALSE);
+	if (!boxed)
+		return;
+	// The sides of the box have been scrolled away from the new rows
+	auto count = std::min(std::abs(lines), rows);
+	auto first = lines > 0 ? bottom - count + 1 : top;
+	for (auto y = first; y < first + count; ++y)
+	{
+		mvwaddch(win(), y, 0, ACS_VLINE);
+		mvwaddch(win(), y, window.w() - 1, ACS_VLINE);
+	}
+}
+
+void tui::CursesWidget::postRedraw()
+{
+	if (redrawPosted.exchange(true))
+		return;
+	auto flag = alive;
+	CdkApp::getCdkApp()->post([this, flag]()
+			{
+				if (!*flag)
+					return;
+				redrawPosted = false;
+				draw(boxed);
+			});
+}
+
+void tui::CursesWidget::search(const std::string & query, SearchOptions options)
+{
+	auto source = searchSource();
+	if (!source)
+		return;
+	if (!searcher)
+	{
+		// The batches are delivered on the search thread and added to the
+		// matches by the curses thread
+		auto flag = alive;
+		searcher = std::make_unique<TextSearch>(
+				[this, flag](std::uint64_t generation, std::vector<SearchMatch> found, bool finished)
+				{
+					CdkApp::getCdkApp()->post([this, flag, generation, found, finished]()
+							{
+								if (!*flag || generation != searcher->getGeneration())
+									return;
+								matches.insert(matches.end(), found.begin(), found.end());
+								if (finished)
+									searching = false;
+								if (!found.empty())
+								{
+									invalidateAll();
+									screenPtr->commit();
+								}
+							});
+				});
+	}
+	searcher->start(std::move(source), query, options);
+	searching = true;
+	matches.clear();
+	invalidateAll();
+	screenPtr->commit();
+}
+
+void tui::CursesWidget::cancelSearch()
+{
+	if (searcher)
+		searcher->cancel();
+	searching = false;
+}
+
+void tui::CursesWidget::clearSearch()
+{
+	cancelSearch();
+	if (matches.empty())
+		return;
+	matches.clear();
+	invalidateAll();
+	screenPtr->commit();
+}
+
+void tui::CursesWidget::highlightMatches(int row, std::size_t line, long shift, chtype attribute)
+{
+	auto byLine = [](const SearchMatch & a, const SearchMatch & b)
+	{
+		return a.line < b.line;
+	};
+	auto range = std::equal_range(matches.begin(), matches.end(), SearchMatch{line, 0, 0}, byLine);
+	auto cols = static_cast<long>(contentCols());
+	auto highlight = (attribute | matchAttribute) & A_ATTRIBUTES & ~A_COLOR;
+	for (auto match = range.first; match != range.second; ++match)
+	{
+		auto begin = std::max(shift + static_cast<long>(match->column), 0L);
+		auto end = std::min(shift + static_cast<long>(match->column + match->length), cols);
+		if (begin < end)
+			mvwchgat(win(), contentTop() + row, contentLeft() + begin, end - begin,
+					highlight, PAIR_NUMBER(attribute), nullptr);
+	}
+}
+
+std::size_t tui::CursesWidget::matchLine(std::size_t from, bool forward) const
+{
+	auto byLine = [](const SearchMatch & a, const SearchMatch & b)
+	{
+		return a.line < b.line;
+	};
+	if (forward)
+	{
+		auto found = std::upper_bound(matches.begin(), matches.end(), SearchMatch{from, 0, 0}, byLine);
+		return found == matches.end() ? noMatch : found->line;
+	}
+	auto found = std::lower_bound(matches.begin(), matches.end(), SearchMatch{from, 0, 0}, byLine);
+	return found == matches.begin() ? noMatch : std::prev(found)->line;
+}
+
+/******************************************************************************
+
+  Virtual List
+
+******************************************************************************/
+
+namespace
+{
+	/// Search source asking the provider of a virtual list for the items
+	class ProviderSource : public tui::SearchSource
+	{
+		public:
+			ProviderSource(tui::CdkVirtualList::Provider provider, std::size_t count)
+				: provider(std::move(provider)), count(count)
+			{
+			}
+
+			std::size_t lineCount() const override
+			{
+				return count;
+			}
+
+			void line(std::size_t n, std::string & buffer, const char *& text, std::size_t & length) const override
+			{
+				buffer.clear();
+				provider(n, buffer);
+				text = buffer.data();
+				length = buffer.size();
+			}
+
+		private:
+			tui::CdkVirtualList::Provider provider;
+			std::size_t count;
+	};
+}
+
+tui::CdkVirtualList::CdkVirtualList(CdkScreen & screen, int xrel, int yrel, int height, int width,
+		const std::string & title, std::size_t count, Provider provider,
+		chtype choiceCharacter, chtype highlight, bool box)
+	: CursesWidget(screen, xrel, yrel, height, width, title, box),
+	provider(std::move(provider)), count(count), choiceCharacter(choiceCharacter), highlight(highlight)
+{
+}
+
+tui::CdkVirtualList::~CdkVirtualList()
+{
+	// The search calls the provider
+	cancelSearch();
+}
+
+std::shared_ptr<const tui::SearchSource> tui::CdkVirtualList::searchSource()
+{
+	return std::make_shared<ProviderSource>(provider, count);
+}
+
+void tui::CdkVirtualList::setValue(std::size_t index)
+{
+	selected = index < count ? index : none;
+	invalidateAll();
+}
+
+void tui::CdkVirtualList::setCurrent(std::size_t index)
+{
+	if (count == 0)
+		return;
+	current = std::min(index, count - 1);
+	auto rows = static_cast<std::size_t>(std::max(contentRows(), 1));
+	if (current < top)
+		top = current;
+	else if (current >= top + rows)
+		top = current - rows + 1;
+	// renderContent scrolls the rows and only draws those which have changed
+	invalidate();
+}
+
+void tui::CdkVirtualList::setCount(std::size_t nbrItems)
+{
+	count = nbrItems;
+	if (selected != none && selected >= count)
+		selected = none;
+	auto rows = static_cast<std::size_t>(std::max(contentRows(), 1));
+	// Keep the list filled when items are removed at the end
+	top = count > rows ? std::min(top, count - rows) : 0;
+	setCurrent(count == 0 ? 0 : std::min(current, count - 1));
+	invalidateAll();
+}
+
+std::size_t tui::CdkVirtualList::rowPrefix(std::size_t index, char * prefix)
+{
+	prefix[0] = index == selected ? static_cast<char>(choiceCharacter & A_CHARTEXT) : ' ';
+	prefix[1] = ' ';
+	return 2;
+}
+
+void tui::CdkVirtualList::renderContent(bool full)
+{
+	auto rows = static_cast<std::size_t>(std::max(contentRows(), 0));
+	// Rows still showing the right item: the others are drawn
+	std::size_t keptFirst = 0;
+	std::size_t keptLast = 0;
+	if (!full)
+	{
+		auto delta = static_cast<long>(top) - static_cast<long>(drawnTop);
+		if (static_cast<std::size_t>(std::abs(delta)) < rows)
+		{
+			scrollContent(static_cast<int>(delta));
+			keptFirst = delta < 0 ? static_cast<std::size_t>(-delta) : 0;
+			keptLast = delta > 0 ? rows - static_cast<std::size_t>(delta) : rows;
+		}
+	}
+	for (std::size_t row = 0; row < rows; ++row)
+	{
+		auto index = top + row;
+		// The highlight moves from the previous current item to the new one
+		if (row < keptFirst || row >= keptLast || index == current || index == drawnCurrent)
+			drawItem(row);
+	}
+	drawnTop = top;
+	drawnCurrent = current;
+}
+
+void tui::CdkVirtualList::drawItem(std::size_t row)
+{
+	auto index = top + row;
+	if (index >= count)
+	{
+		drawRow(row, "", 0);
+		return;
+	}
+	// The provider gets an empty text, whether it assigns or appends the item
+	char prefix[8];
+	auto length = rowPrefix(index, prefix);
+	itemText.clear();
+	provider(index, itemText);
+	rowText.assign(prefix, length);
+	rowText += itemText;
+	auto attribute = index == current ? highlight : A_NORMAL;
+	drawRow(row, rowText.data(), rowText.size(), attribute);
+	highlightMatches(row, index, static_cast<long>(length), attribute);
+}
+
+void tui::CdkVirtualList::moveCurrent(long delta)
+{
+	if (count == 0)
+		return;
+	long target = static_cast<long>(current) + delta;
+	target = std::max(0L, std::min(target, static_cast<long>(count) - 1));
+	setCurrent(static_cast<std::size_t>(target));
+}
+
+EExitType tui::CdkVirtualList::processKey(chtype key)
+{
+	auto page = std::max(contentRows() - 1, 1);
+	switch (key)
+	{
+		case KEY_UP:
+			moveCurrent(-1);
+			break;
+		case KEY_DOWN:
+			moveCurrent(1);
+			break;
+		case KEY_PPAGE:
+			moveCurrent(-page);
+			break;
+		case KEY_NPAGE:
+			moveCurrent(page);
+			break;
+		case KEY_HOME:
+			setCurrent(0);
+			break;
+		case KEY_END:
+			setCurrent(count == 0 ? 0 : count - 1);
+			break;
+		case ' ':
+			setValue(current);
+			break;
+		case 'n':
+		case 'N':
+		{
+			auto line = matchLine(current, key == 'n');
+			if (line != noMatch)
+				setCurrent(line);
+			break;
+		}
+		case KEY_ENTER:
+		case '\n':
+		case '\r':
+		case '\t':
+			if (selected == none)
+				setValue(current);
+			return vNORMAL;
+		case 27: // Escape
+			return vESCAPE_HIT;
+		default:
+			break;
+	}
+	return vEARLY_EXIT;
+}
+
+/******************************************************************************
+
+  Fuzzy List
+
+******************************************************************************/
+
+namespace
+{
+	/// Search source over the items matching the query when the search
+	/// started. The search thread never reads the filter, which the curses
+	/// thread changes at each key
+	class RankedSource : public tui::SearchSource
+	{
+		public:
+			RankedSource(tui::CdkVirtualList::Provider items, std::vector<std::size_t> ranked)
+				: items(std::move(items)), ranked(std::move(ranked))
+			{
+			}
+
+			std::size_t lineCount() const override
+			{
+				return ranked.size();
+			}
+
+			void line(std::size_t n, std::string & buffer, const char *& text, std::size_t & length) const override
+			{
+				buffer.clear();
+				items(ranked[n], buffer);
+				text = buffer.data();
+				length = buffer.size();
+			}
+
+		private:
+			tui::CdkVirtualList::Provider items;
+			std::vector<std::size_t> ranked;
+	};
+}
+
+tui::CdkFuzzyList::CdkFuzzyList(CdkScreen & screen, int xrel, int yrel, int height, int width,
+		const std::string & title, std::size_t count, Provider items, chtype highlight, bool box)
+	: CdkVirtualList(screen, xrel, yrel, height, width, title, count,
+			[this](std::size_t row, std::string & text) { this->items(filter.getItem(row), text); },
+			' ', highlight, box),
+	items(std::move(items)), filter(count, [this](std::size_t index, std::string & text) { this->items(index, text); })
+{
+}
+
+tui::CdkFuzzyList::~CdkFuzzyList()
+{
+	if (timer >= 0)
+		CdkApp::getCdkApp()->getEventLoop().removeTimer(timer);
+}
+
+void tui::CdkFuzzyList::setQuery(const std::string & query)
+{
+	if (!filter.setQuery(query))
+		return;
+	// The matches of a search are rows of the previous query
+	clearSearch();
+	// The first rows are displayed in this frame, the filtering goes on in the
+	// next ones if the budget is not enough
+	filterStep();
+	if (!filter.isDone() && timer < 0)
+		timer = CdkApp::getCdkApp()->getEventLoop().addTimer(std::chrono::milliseconds(16),
+				std::chrono::milliseconds(16), [this]() { filterStep(); });
+}
+
+void tui::CdkFuzzyList::filterStep()
+{
+	auto done = filter.step(budget);
+	setCount(filter.getCount());
+	// The matches are ranked at the end: the cursor goes back to the best one,
+	// and a search started before refers to rows which have moved
+	if (done)
+	{
+		setCurrent(0);
+		clearSearch();
+	}
+	if (done && timer >= 0)
+	{
+		CdkApp::getCdkApp()->getEventLoop().removeTimer(timer);
+		timer = -1;
+	}
+	// Only the visible rows are asked to the provider
+	draw(boxed);
+}
+
+std::shared_ptr<const tui::SearchSource> tui::CdkFuzzyList::searchSource()
+{
+	std::vector<std::size_t> ranked(filter.getCount());
+	for (std::size_t row = 0; row < ranked.size(); ++row)
+		ranked[row] = filter.getItem(row);
+	return std::make_shared<RankedSource>(items, std::move(ranked));
+}
+
+std::size_t tui::CdkFuzzyList::getItem() const
+{
+	if (getCount() == 0)
+		return none;
+	return filter.getItem(getCurrent());
+}
+
+void tui::CdkFuzzyList::attach(CdkEntry & entry)
+{
+	entry.registerCallback(KeyCallback::bind<CdkFuzzyList, &CdkFuzzyList::entryKey>(*this));
+}
+
+int tui::CdkFuzzyList::entryKey(CdkWidget & widget, chtype key)
+{
+	switch (key)
+	{
+		case KEY_UP:
+		case KEY_DOWN:
+		case KEY_PPAGE:
+		case KEY_NPAGE:
+			inject(key);
+			return 1;
+		default:
+			break;
+	}
+	auto value = static_cast<CdkEntry &>(widget).getValue();
+	setQuery(value != nullptr ? value : "");
+	return 1;
+}
+
+/******************************************************************************
+
+  Log Tail
+
+******************************************************************************/
+
+tui::CdkLogTail::CdkLogTail(CdkScreen & screen, int xrel, int yrel, int height, int width,
+		const std::string & title, std::size_t capacity, bool box)
+	: CursesWidget(screen, xrel, yrel, height, width, title, box),
+	lines(std::max<std::size_t>(capacity, 1))
+{
+}
+
+tui::CdkLogTail::~CdkLogTail()
+{
+}
+
+void tui::CdkLogTail::append(const char * text, std::size_t length)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		// The slot keeps its memory: no allocation once it is large enough
+		lines[head % lines.size()].assign(text, length);
+		++head;
+	}
+	// A single redraw is posted until the curses thread has run it, however
+	// many lines are appended meanwhile
+	postRedraw();
+}
+
+void tui::CdkLogTail::clear()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		head = 0;
+	}
+	drawnHead = 0;
+	offset = 0;
+	invalidateAll();
+}
+
+std::uint64_t tui::CdkLogTail::getCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return head;
+}
+
+std::size_t tui::CdkLogTail::copyLines(std::uint64_t first, std::uint64_t last)
+{
+	// The copies keep their memory from one frame to the next
+	auto count = static_cast<std::size_t>(last - first);
+	if (copied.size() < count)
+		copied.resize(count);
+	for (auto seq = first; seq < last; ++seq)
+	{
+		auto & line = lines[seq % lines.size()];
+		copied[static_cast<std::size_t>(seq - first)].assign(line.data(), line.size());
+	}
+	return count;
+}
+
+void tui::CdkLogTail::renderContent(bool full)
+{
+	auto rows = static_cast<std::uint64_t>(std::max(contentRows(), 0));
+	std::uint64_t newLines{};
+	std::uint64_t visible{};
+	std::size_t count{};
+	{
+		// The lines are copied under the lock and drawn once it is released,
+		// so that the producers never wait for curses
+		std::lock_guard<std::mutex> lock(mutex);
+		auto stored = std::min<std::uint64_t>(head, lines.size());
+		newLines = head - drawnHead;
+		drawnHead = head;
+		if (offset != 0)
+		{
+			// The user looks at older lines: they stay in place, unless they
+			// have been overwritten in the ring buffer
+			auto maxOffset = stored > rows ? stored - rows : 0;
+			offset = std::min(offset + newLines, maxOffset);
+			if (newLines == 0 && !full)
+				return;
+			full = true;
+		}
+		// Newest line displayed at the bottom of the widget. There are fewer
+		// visible lines than rows when the buffer is smaller than the widget
+		auto last = head - offset;
+		visible = std::min(rows, std::min<std::uint64_t>(stored, last));
+		if (!full && newLines < visible)
+		{
+			if (newLines == 0)
+				return;
+			count = copyLines(last - newLines, last);
+		}
+		else
+		{
+			full = true;
+			count = copyLines(last - visible, last);
+		}
+	}
+	if (!full)
+	{
+		// Only the new lines are drawn, the others are scrolled. The rows
+		// scrolled above the visible lines held lines no longer kept
+		scrollContent(static_cast<int>(newLines));
+		auto top = rows - visible;
+		for (auto row = top > newLines ? top - newLines : 0; row < top; ++row)
+			drawRow(static_cast<int>(row), "", 0);
+	}
+	else
+	{
+		// The top rows stay empty while there are fewer lines than rows
+		for (std::uint64_t row = 0; row < rows - visible; ++row)
+			drawRow(static_cast<int>(row), "", 0);
+	}
+	auto firstRow = rows - count;
+	for (std::size_t index = 0; index < count; ++index)
+		drawRow(static_cast<int>(firstRow + index), copied[index].data(), copied[index].size());
+}
+
+void tui::CdkLogTail::scrollBack(long delta)
+{
+	std::uint64_t stored{};
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stored = std::min<std::uint64_t>(head, lines.size());
+	}
+	auto rows = static_cast<std::uint64_t>(std::max(contentRows(), 0));
+	auto maxOffset = static_cast<long>(stored > rows ? stored - rows : 0);
+	auto target = std::max(0L, std::min(static_cast<long>(offset) + delta, maxOffset));
+	offset = static_cast<std::uint64_t>(target);
+	invalidateAll();
+}
+
+EExitType tui::CdkLogTail::processKey(chtype key)
+{
+	auto page = std::max(contentRows() - 1, 1);
+	switch (key)
+	{
+		case KEY_UP:
+			scrollBack(1);
+			break;
+		case KEY_DOWN:
+			scrollBack(-1);
+			break;
+		case KEY_PPAGE:
+			scrollBack(page);
+			break;
+		case KEY_NPAGE:
+			scrollBack(-page);
+			break;
+		case KEY_END:
+			offset = 0;
+			invalidateAll();
+			break;
+		case KEY_ENTER:
+		case '\n':
+		case '\r':
+		case '\t':
+			return vNORMAL;
+		case 27: // Escape
+			return vESCAPE_HIT;
+		default:
+			break;
+	}
+	return vEARLY_EXIT;
+}
+
+/******************************************************************************
+
+  File Viewer
+
+******************************************************************************/
+
+tui::CdkFileViewer::CdkFileViewer(CdkScreen & screen, int xrel, int yrel, int height, int width,
+		const std::string & title, const std::string & path, bool box)
+	: CursesWidget(screen, xrel, yrel, height, width, title, box),
+	file(path), index(file, [this]() { indexed(); })
+{
+}
+
+tui::CdkFileViewer::~CdkFileViewer()
+{
+	// The search reads the index
+	cancelSearch();
+}
+
+void tui::CdkFileViewer::indexed()
+{
+	// Called from the indexing thread: the redraw is done by the curses thread,
+	// once whatever the number of chunks indexed meanwhile. Only the rows which
+	// were blank may have to be drawn
+	postRedraw();
+}
+
+namespace
+{
+	/// Search source reading the lines of the index of a file viewer
+	class IndexSource : public tui::SearchSource
+	{
+		public:
+			explicit IndexSource(const tui::LineIndex & index)
+				: index(index)
+			{
+			}
+
+			std::size_t lineCount() const override
+			{
+				return index.getCount();
+			}
+
+			bool isComplete() const override
+			{
+				return index.isComplete();
+			}
+
+			void line(std::size_t n, std::string &, const char *& text, std::size_t & length) const override
+			{
+				index.getLine(n, text, length);
+			}
+
+		private:
+			const tui::LineIndex & index;
+	};
+}
+
+std::shared_ptr<const tui::SearchSource> tui::CdkFileViewer::searchSource()
+{
+	return std::make_shared<IndexSource>(index);
+}
+
+void tui::CdkFileViewer::setTop(std::size_t line)
+{
+	auto count = index.getCount();
+	auto rows = static_cast<std::size_t>(std::max(contentRows(), 1));
+	line = count > rows ? std::min(line, count - rows) : 0;
+	if (line == top)
+		return;
+	top = line;
+	// renderContent scrolls the rows and only draws those which appear
+	invalidate();
+}
+
+void tui::CdkFileViewer::setLeft(std::size_t column)
+{
+	if (column == left)
+		return;
+	left = column;
+	invalidateAll();
+}
+
+void tui::CdkFileViewer::renderContent(bool full)
+{
+	auto rows = static_cast<std::size_t>(std::max(contentRows(), 0));
+	auto count = index.getCount();
+	// Rows still showing the right line, the others are drawn. When lines
+	// have been indexed, the rows which were blank are drawn
+	long keptFirst = 0;
+	long keptLast = 0;
+	if (!full)
+	{
+		auto delta = static_cast<long>(top) - static_cast<long>(drawnTop);
+		if (std::abs(delta) < static_cast<long>(rows))
+		{
+			scrollContent(static_cast<int>(delta));
+			keptFirst = std::max(-delta, 0L);
+			keptLast = std::min(static_cast<long>(drawnRows) - delta, static_cast<long>(rows));
+		}
+	}
+	for (std::size_t row = 0; row < rows; ++row)
+	{
+		if (static_cast<long>(row) >= keptFirst && static_cast<long>(row) < keptLast)
+			continue;
+		auto line = top + row;
+		if (line >= count)
+		{
+			drawRow(row, "", 0);
+			continue;
+		}
+		const char * text;
+		std::size_t length;
+		index.getLine(line, text, length);
+		// Lines ending with CR LF
+		if (length != 0 && text[length - 1] == '\r')
+			--length;
+		if (length <= left)
+			drawRow(row, "", 0);
+		else
+			drawRow(row, text + left, length - left);
+		highlightMatches(row, line, -static_cast<long>(left));
+	}
+	drawnTop = top;
+	drawnRows = std::min(rows, count > top ? count - top : 0);
+}
+
+EExitType tui::CdkFileViewer::processKey(chtype key)
+{
+	auto page = static_cast<std::size_t>(std::max(contentRows() - 1, 1));
+	auto step = static_cast<std::size_t>(std::max(contentCols() / 2, 1));
+	switch (key)
+	{
+		case KEY_UP:
+			setTop(top > 0 ? top - 1 : 0);
+			break;
+		case KEY_DOWN:
+			setTop(top + 1);
+			break;
+		case KEY_PPAGE:
+			setTop(top > page ? top - page : 0);
+			break;
+		case KEY_NPAGE:
+			setTop(top + page);
+			break;
+		case KEY_LEFT:
+			setLeft(left > step ? left - step : 0);
+			break;
+		case KEY_RIGHT:
+			setLeft(left + step);
+			break;
+		case KEY_HOME:
+			setLeft(0);
+			setTop(0);
+			break;
+		case KEY_END:
+			setTop(index.getCount());
+			break;
+		case 'n':
+		case 'N':
+		{
+			auto line = matchLine(top, key == 'n');
+			if (line != noMatch)
+				setTop(line);
+			break;
+		}
+		case KEY_ENTER:
+		case '\n':
+		case '\r':
+		case '\t':
+			return vNORMAL;
+		case 27: // Escape
+			return vESCAPE_HIT;
+		default:
+			break;
+	}
+	return vEARLY_EXIT;
+}
+
+/******************************************************************************
+
+  Numeric Readout
+
+******************************************************************************/
+
+tui::CdkNumericReadout::CdkNumericReadout(CdkScreen & screen, int xrel, int yrel, int width,
+		const std::string & label, int precision, bool box)
+	: CursesWidget(screen, xrel, yrel, box ? 3 : 1, width, "", box),
+	label(label), precision(precision)
+{
+	auto cols = static_cast<std::size_t>(std::max(contentCols(), 0));
+	field = std::min(cols > label.size() ? cols - label.size() : 0, maxField);
+	std::fill(text, text + maxField, ' ');
+	std::fill(drawnText, drawnText + maxField, ' ');
+}
+
+void tui::CdkNumericReadout::setValue(double value)
+{
+	auto result = std::to_chars(text, text + field, value, std::chars_format::fixed, precision);
+	update(result.ptr, result.ec == std::errc());
+}
+
+void tui::CdkNumericReadout::update(char * end, bool ok)
+{
+	if (ok)
+	{
+		// Right alignment in the field
+		auto length = static_cast<std::size_t>(end - text);
+		std::copy_backward(text, end, text + field);
+		std::fill(text, text + field - length, ' ');
+	}
+	else
+		std::fill(text, text + field, '#');
+	if (std::equal(text, text + field, drawnText))
+	{
+		++skipped;
+		return;
+	}
+	invalidate();
+}
+
+void tui::CdkNumericReadout::renderContent(bool full)
+{
+	auto labelLength = std::min<std::size_t>(label.size(), std::max(contentCols(), 0));
+	if (full && labelLength != 0)
+		mvwaddnstr(win(), contentTop(), contentLeft(), label.data(), static_cast<int>(labelLength));
+	if (field == 0 || (!full && std::equal(text, text + field, drawnText)))
+		return;
+	mvwaddnstr(win(), contentTop(), contentLeft() + static_cast<int>(labelLength), text, static_cast<int>(field));
+	std::copy(text, text + field, drawnText);
+}
+
+EExitType tui::CdkNumericReadout::processKey(chtype key)
+{
+	switch (key)
+	{
+		case KEY_ENTER:
+		case '\n':
+		case '\r':
+		case '\t':
+			return vNORMAL;
+		case 27: // Escape
+			return vESCAPE_HIT;
+		default:
+			break;
+	}
+	return vEARLY_EXIT;
+}
+
+/******************************************************************************
+
+  Editor
+
+******************************************************************************/
+
+tui::CdkEditor::CdkEditor(CdkScreen & screen, int xrel, int yrel, int height, int width,
+		const std::string & title, bool box)
+	: CursesWidget(screen, xrel, yrel, height, width, title, box)
+{
+	lines.insert(0, std::string());
+}
+
+void tui::CdkEditor::setText(const std::string & text)
+{
+	lines.clear();
+	std::size_t start = 0;
+	for (;;)
+	{
+		auto end = text.find('\n', start);
+		if (end == std::string::npos)
+			break;
+		lines.insert(lines.size(), text.substr(start, end - start));
+		start = end + 1;
+	}
+	lines.insert(lines.size(), text.substr(start));
+	cursorLine = cursorColumn = goalColumn = 0;
+	top = left = 0;
+	modified = false;
+	invalidateAll();
+}
+
+std::string tui::CdkEditor::getText() const
+{
+	std::size_t total = 0;
+	for (std::size_t line = 0; line < lines.size(); ++line)
+		total += lines[line].size() + 1;
+	std::string text;
+	text.reserve(total);
+	for (std::size_t line = 0; line < lines.size(); ++line)
+	{
+		if (line != 0)
+			text += '\n';
+		text += lines[line];
+	}
+	return text;
+}
+
+void tui::CdkEditor::markLines(std::size_t first, std::size_t last)
+{
+	if (dirtyFirst == dirtyLast)
+	{
+		dirtyFirst = first;
+		dirtyLast = last;
+	}
+	else
+	{
+		dirtyFirst = std::min(dirtyFirst, first);
+		dirtyLast = std::max(dirtyLast, last);
+	}
+}
+
+void tui::CdkEditor::touchLine(std::size_t line)
+{
+	markLines(line, line + 1);
+	invalidate();
+}
+
+void tui::CdkEditor::touchFrom(std::size_t line)
+{
+	// The rows below the last line must be cleared too
+	markLines(line, static_cast<std::size_t>(-1));
+	invalidate();
+}
+
+void tui::CdkEditor::shiftLines(std::size_t first, long delta)
+{
+	invalidate();
+	if (!shiftBroken && shiftDelta == 0)
+	{
+		shiftStart = first;
+		shiftDelta = delta;
+		return;
+	}
+	// The lines moved again from the end of the block already moved: the
+	// block moves further
+	if (!shiftBroken && static_cast<long>(first) == static_cast<long>(shiftStart) + shiftDelta)
+	{
+		shiftDelta += delta;
+		return;
+	}
+	auto from = std::min(static_cast<long>(first) + std::min(delta, 0L),
+			static_cast<long>(shiftStart) + std::min(shiftDelta, 0L));
+	if (shiftBroken)
+		from = static_cast<long>(first) + std::min(delta, 0L);
+	touchFrom(static_cast<std::size_t>(std::max(from, 0L)));
+	shiftBroken = true;
+	shiftDelta = 0;
+}
+
+void tui::CdkEditor::setCursor(std::size_t line, std::size_t column)
+{
+	moveCursor(line, column);
+	goalColumn = cursorColumn;
+}
+
+void tui::CdkEditor::moveCursor(std::size_t line, std::size_t column)
+{
+	line = std::min(line, lines.size() - 1);
+	column = std::min(column, lines[line].size());
+	touchLine(cursorLine);
+	touchLine(line);
+	cursorLine = line;
+	cursorColumn = column;
+	// Vertical scrolling only draws the rows which appear
+	auto rows = static_cast<std::size_t>(std::max(contentRows(), 1));
+	if (cursorLine < top)
+		top = cursorLine;
+	else if (cursorLine >= top + rows)
+		top = cursorLine - rows + 1;
+	auto cols = static_cast<std::size_t>(std::max(contentCols() - 1, 1));
+	if (cursorColumn < left || cursorColumn > left + cols)
+	{
+		left = cursorColumn > cols / 2 ? cursorColumn - cols / 2 : 0;
+		invalidateAll();
+	}
+}
+
+void tui::CdkEditor::insert(const std::string & text)
+{
+	for (auto c : text)
+	{
+		if (c == '\n')
+			newLine();
+		else if (c != '\r')
+			insertChar(c);
+	}
+	goalColumn = cursorColumn;
+}
+
+void tui::CdkEditor::insertChar(char c)
+{
+	lines[cursorLine].insert(cursorColumn, 1, c);
+	modified = true;
+	moveCursor(cursorLine, cursorColumn + 1);
+}
+
+void tui::CdkEditor::newLine()
+{
+	auto & line = lines[cursorLine];
+	auto rest = line.substr(cursorColumn);
+	line.erase(cursorColumn);
+	lines.insert(cursorLine + 1, std::move(rest));
+	modified = true;
+	touchLine(cursorLine);
+	touchLine(cursorLine + 1);
+	shiftLines(cursorLine + 1, 1);
+	moveCursor(cursorLine + 1, 0);
+}
+
+void tui::CdkEditor::backspace()
+{
+	if (cursorColumn > 0)
+	{
+		lines[cursorLine].erase(cursorColumn - 1, 1);
+		modified = true;
+		moveCursor(cursorLine, cursorColumn - 1);
+	}
+	else if (cursorLine > 0)
+	{
+		// Join with the previous line
+		auto previous = cursorLine - 1;
+		auto column = lines[previous].size();
+		lines[previous] += lines[cursorLine];
+		lines.erase(cursorLine);
+		modified = true;
+		touchLine(previous);
+		shiftLines(cursorLine + 1, -1);
+		moveCursor(previous, column);
+	}
+}
+
+void tui::CdkEditor::deleteChar()
+{
+	auto & line = lines[cursorLine];
+	if (cursorColumn < line.size())
+	{
+		line.erase(cursorColumn, 1);
+		modified = true;
+		touchLine(cursorLine);
+	}
+	else if (cursorLine + 1 < lines.size())
+	{
+		line += lines[cursorLine + 1];
+		lines.erase(cursorLine + 1);
+		modified = true;
+		touchLine(cursorLine);
+		shiftLines(cursorLine + 2, -1);
+	}
+}
+
+void tui::CdkEditor::drawLine(int row, std::size_t line)
+{
+	if (line >= lines.size())
+	{
+		drawRow(row, "", 0);
+		return;
+	}
+	auto & text = lines[line];
+	if (text.size() > left)
+		drawRow(row, text.data() + left, text.size() - left);
+	else
+		drawRow(row, "", 0);
+	if (line == cursorLine && cursorColumn >= left
+			&& cursorColumn - left < static_cast<std::size_t>(contentCols()))
+		mvwchgat(win(), contentTop() + row, contentLeft() + static_cast<int>(cursorColumn - left), 1,
+				A_REVERSE, 0, nullptr);
+}
+
+void tui::CdkEditor::renderContent(bool full)
+{
+	auto rows = static_cast<std::size_t>(std::max(contentRows(), 0));
+	if (!full && top != drawnTop)
+	{
+		auto delta = static_cast<long>(top) - static_cast<long>(drawnTop);
+		if (static_cast<std::size_t>(std::abs(delta)) < rows)
+		{
+			// The rows are scrolled, the rows which appear are drawn
+			scrollContent(static_cast<int>(delta));
+			if (delta > 0)
+				markLines(top + rows - delta, top + rows);
+			else
+				markLines(top, top - delta);
+		}
+		else
+			full = true;
+	}
+	if (!full && shiftDelta != 0)
+	{
+		// The lines below the edit are scrolled, as a split or a join moves
+		// them by a few rows; the rows which appear are drawn
+		auto first = static_cast<long>(std::min<std::size_t>(shiftStart, shiftStart + shiftDelta));
+		auto firstRow = first - static_cast<long>(top);
+		auto height = static_cast<long>(rows) - firstRow;
+		auto count = std::abs(shiftDelta);
+		if (top != drawnTop || firstRow < 0)
+			markLines(static_cast<std::size_t>(std::max(first, static_cast<long>(top))), static_cast<std::size_t>(-1));
+		else if (height <= count)
+			markLines(static_cast<std::size_t>(first), static_cast<std::size_t>(-1));
+		else if (height > 0)
+		{
+			scrollContent(static_cast<int>(-shiftDelta), static_cast<int>(firstRow));
+			if (shiftDelta > 0)
+				markLines(static_cast<std::size_t>(first), static_cast<std::size_t>(first + count));
+			else
+				markLines(top + rows - static_cast<std::size_t>(count), top + rows);
+		}
+	}
+	shiftDelta = 0;
+	shiftBroken = false;
+	drawnTop = top;
+	for (std::size_t row = 0; row < rows; ++row)
+	{
+		auto line = top + row;
+		if (full || (line >= dirtyFirst && line < dirtyLast))
+			drawLine(static_cast<int>(row), line);
+	}
+	dirtyFirst = dirtyLast = 0;
+}
+
+EExitType tui::CdkEditor::processKey(chtype key)
+{
+	auto page = static_cast<std::size_t>(std::max(contentRows() - 1, 1));
+	switch (key)
+	{
+		case KEY_UP:
+			if (cursorLine > 0)
+				moveCursor(cursorLine - 1, goalColumn);
+			break;
+		case KEY_DOWN:
+			moveCursor(cursorLine + 1, goalColumn);
+			break;
+		case KEY_PPAGE:
+			moveCursor(cursorLine > page ? cursorLine - page : 0, goalColumn);
+			break;
+		case KEY_NPAGE:
+			moveCursor(cursorLine + page, goalColumn);
+			break;
+		case KEY_LEFT:
+			if (cursorColumn > 0)
+				setCursor(cursorLine, cursorColumn - 1);
+			else if (cursorLine > 0)
+				setCursor(cursorLine - 1, lines[cursorLine - 1].size());
+			break;
+		case KEY_RIGHT:
+			if (cursorColumn < lines[cursorLine].size())
+				setCursor(cursorLine, cursorColumn + 1);
+			else if (cursorLine + 1 < lines.size())
+				setCursor(cursorLine + 1, 0);
+			break;
+		case KEY_HOME:
+			setCursor(cursorLine, 0);
+			break;
+		case KEY_END:
+			setCursor(cursorLine, lines[cursorLine].size());
+			break;
+		case KEY_ENTER:
+		case '\n':
+		case '\r':
+			newLine();
+			goalColumn = 0;
+			break;
+		case KEY_BACKSPACE:
+		case 127:
+		case 8:
+			backspace();
+			goalColumn = cursorColumn;
+			break;
+		case KEY_DC:
+			deleteChar();
+			break;
+		case '\t':
+			do
+				insertChar(' ');
+			while (cursorColumn % tabWidth != 0);
+			goalColumn = cursorColumn;
+			break;
+		case 24: // Ctrl-X
+			return vNORMAL;
+		case 27: // Escape
+			return vESCAPE_HIT;
+		default:
+			if (key >= ' ' && key < 256)
+			{
+				insertChar(static_cast<char>(key));
+				goalColumn = cursorColumn;
+			}
+			break;
+	}
+	return vEARLY_EXIT;
+}
@@ -0,0 +1,780 @@
+#ifndef TUI_CURSES_WIDGETS_H
+#define TUI_CURSES_WIDGETS_H
+
+#include "cdk_support.h"
+#include "fuzzy.h"
+#include "gap_buffer.h"
+#include "mapped_file.h"
+#include "search.h"
+#include <atomic>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+
+namespace tui
+
+{
+
+/****************************************************************************//*
+class CursesWidget
+Base class of the widgets which are drawn directly with curses instead of being
+CDK objects. They are used when the CDK widgets would need the whole content in
+memory, or would redraw more than what has changed.
+
+The widget owns a curses window. render() draws the box and the title when
+needed, then calls renderContent() which only draws what has changed unless a
+full redraw is requested. The keys go through preProcess, processKey and
+postProcess, in the same way as for the CDK widgets.
+
+The widgets which provide a search source can be searched without copying
+their content: the search runs on a background thread (see TextSearch) and
+the matches are highlighted as their batches arrive.
+
+******************************************************************************/
+class CursesWidget : public CdkWidget
+{
+public:
+	/// Constructors
+	CursesWidget(CdkScreen & screen, //< Screen where the widget is located
+			int xrel, //< Relative position from the screen
+			int yrel, //< Relative position from the screen
+			int height, //< Height of the widget including the box
+			int width, //< Width of the widget including the box
+			const std::string & title, //< Title displayed at the top of the widget
+			bool box //< True to draw a box around the widget
+			);
+
+	/// Destructor
+	~CursesWidget();
+
+	/// Activate the widget and process the keys until it is exited. If actions
+	/// is given, the keys are taken from this zero terminated array instead.
+	EExitType activate(chtype * actions = nullptr) override;
+
+	/// Process a single key. This is the non blocking version of activate
+	EExitType inject(chtype key) override;
+
+	/// Erase from the screen without destroying it
+	void erase() override;
+
+	/// Move the widget to an absolute or relative position
+	void move(int xpos, int ypos, bool relative = false, bool refresh = false) override;
+
+	/// Raise this object: it is redrawn entirely on top of the others
+	void raise() override;
+
+	/// Curses windows are not stacked, the last drawn is on top
+	void lower() override
+	{
+	}
+
+	/// There is no underlying CDK object
+	void* getCDKObject() override
+	{
+		return nullptr;
+	}
+
+	/// Search text in the widget. The search runs on a background thread and
+	/// the matches are highlighted as they are found. A new search cancels the
+	/// current one. Throws std::regex_error if the regular expression is invalid.
+	/// The search thread reads the lines while the widget is drawn: the
+	/// functions giving the lines of a widget, such as the provider of a
+	/// CdkVirtualList, are then called from both threads at the same time
+	void search(const std::string & query, SearchOptions options = {});
+
+	/// Cancel the search and remove the highlights
+	void clearSearch();
+
+	/// Matches found so far, sorted by line and column
+	const std::vector<SearchMatch> & getMatches() const
+	{
+		return matches;
+	}
+
+	/// True while the search goes on
+	bool isSearching() const
+	{
+		return searching;
+	}
+
+	/// Attribute added to the matches
+	void setMatchAttribute(chtype attribute)
+	{
+		matchAttribute = attribute;
+		invalidateAll();
+	}
+
+	/// Index returned when there is no match
+	static constexpr std::size_t noMatch = static_cast<std::size_t>(-1);
+
+protected:
+
+	/// The keys are not received from CDK but through inject
+	void setHandlers(PROCESSFN, PROCESSFN) override
+	{
+	}
+
+	/// Draw the box and the title if needed, then the content
+	void render(bool box) override;
+
+	/// The window is staged with wnoutrefresh and sent by the frame
+	bool flushesOnRender() const override
+	{
+		return false;
+	}
+
+	/// Draw the content of the widget. If full is false, only the parts which
+	/// have changed since the last call need to be drawn.
+	virtual void renderContent(bool full) = 0;
+
+	/// Process a key which has been accepted by preProcess. Returns vEARLY_EXIT
+	/// while the widget stays active
+	virtual EExitType processKey(chtype key) = 0;
+
+	/// Request the whole widget to be drawn again at the next render
+	void invalidateAll()
+	{
+		fullRedraw = true;
+		invalidate();
+	}
+
+	/// Area available for the content, inside the box and below the title
+	int contentTop() const
+	{
+		return (boxed ? 1 : 0) + (title.empty() ? 0 : 1);
+	}
+	int contentLeft() const
+	{
+		return boxed ? 1 : 0;
+	}
+	int contentRows() const
+	{
+		return window.h() - contentTop() - (boxed ? 1 : 0);
+	}
+	int contentCols() const
+	{
+		return window.w() - 2 * contentLeft();
+	}
+
+	/// Write text on a row of the content area. The rest of the row is cleared
+	/// without touching the box
+	void drawRow(int row, const char * text, std::size_t length, chtype attribute = A_NORMAL);
+
+	/// Scroll the rows of the content area up (lines > 0) or down (lines < 0).
+	/// Only the rows from firstRow to the bottom of the area are scrolled.
+	/// The rows which appear are blank and must be drawn by the caller. When
+	/// the terminal can insert and delete lines, curses sends the scroll with
+	/// a scroll region and only the rows which appear are transmitted. The
+	/// scroll regions of the terminals span its whole width: a window narrower
+	/// than the terminal is sent again row by row
+	void scrollContent(int lines, int firstRow = 0);
+
+	/// Curses window of the widget
+	WINDOW * win()
+	{
+		return window.getPtr();
+	}
+
+	/// Redraw the widget from the curses thread. This can be called from any
+	/// thread: one redraw is posted until it has run
+	void postRedraw();
+
+	/// Lines searched by search(), nullptr if the widget cannot be searched
+	virtual std::shared_ptr<const SearchSource> searchSource()
+	{
+		return nullptr;
+	}
+
+	/// Cancel the search. The destructors of the widgets whose search source
+	/// refers to their members must call it
+	void cancelSearch();
+
+	/// Highlight the matches of a line drawn on a row. shift is the column of
+	/// the row where the line starts, and attribute the attribute of the row
+	void highlightMatches(int row, std::size_t line, long shift, chtype attribute = A_NORMAL);
+
+	/// Line of the first match after line from (before it if forward is
+	/// false). Returns noMatch if there is none
+	std::size_t matchLine(std::size_t from, bool forward) const;
+
+	/// Set to false by the destructor so that posted updates do nothing
+	std::shared_ptr<bool> alive;
+
+private:
+	/// Curses window of the widget
+	Window window;
+	/// Title displayed at the top of the widget
+	std::string title;
+	/// True when the box, the title and the content must all be drawn again
+	bool fullRedraw = true;
+	/// Box flag used the last time the widget was drawn
+	bool drawnBox = false;
+	/// True when a redraw has been posted to the curses thread and not run yet
+	std::atomic<bool> redrawPosted{false};
+	/// Search thread, created by the first search
+	std::unique_ptr<TextSearch> searcher{};
+	std::vector<SearchMatch> matches{};
+	bool searching = false;
+	chtype matchAttribute = A_BOLD | A_UNDERLINE;
+};
+
+/****************************************************************************//*
+class CdkVirtualList
+List of items which only asks for the rows it displays. The items are obtained
+from a provider function, so a list of millions of items costs no memory and
+scrolling costs O(visible rows) whatever the number of items.
+
+The list works like CdkRadio: the space bar selects the current item, Enter or
+Tab exits the list and Escape cancels it. After a search, n and N move to the
+next and to the previous match.
+
+******************************************************************************/
+class CdkVirtualList : public CursesWidget
+{
+public:
+	/// Function writing in text the item at index. The text is empty when the
+	/// function is called. A search calls the provider from the search thread
+	/// while the list calls it to draw its rows: the provider of a list which
+	/// is searched must be thread safe, for instance reading items which do
+	/// not change
+	using Provider = std::function<void(std::size_t index, std::string & text)>;
+	/// Index returned when no item is selected
+	static constexpr std::size_t none = static_cast<std::size_t>(-1);
+
+	/// Constructors
+	CdkVirtualList(CdkScreen & screen, //< Screen where the widget is located
+			int xrel, //< Relative position from the screen
+			int yrel, //< Relative position from the screen
+			int height, //< Widget height
+			int width, //< Widget width
+			const std::string & title, //< Title displayed at the top of the widget
+			std::size_t count, //< Number of items
+			Provider provider, //< Function giving the text of the items
+			chtype choiceCharacter = 'X', //< Character marking the selected item
+			chtype highlight = A_REVERSE, //< Attribute of the current item
+			bool box = true
+			);
+
+	/// Destructor
+	~CdkVirtualList();
+
+	/// Get the index of the selected item, none if no item is selected
+	std::size_t getValue() const
+	{
+		return selected;
+	}
+
+	/// Select an item
+	void setValue(std::size_t index);
+
+	/// Get the index of the item under the cursor
+	std::size_t getCurrent() const
+	{
+		return current;
+	}
+
+	/// Move the cursor to an item, scrolling the list if needed
+	void setCurrent(std::size_t index);
+
+	/// Return the number of items
+	std::size_t getCount() const
+	{
+		return count;
+	}
+
+	/// Change the number of items. The provider is asked again for the
+	/// visible rows
+	void setCount(std::size_t nbrItems);
+
+	/// The provider has changed the content of the items: the visible rows are
+	/// asked again
+	void reload()
+	{
+		invalidateAll();
+	}
+
+protected:
+
+	void renderContent(bool full) override;
+	EExitType processKey(chtype key) override;
+
+	/// Write the prefix of the row of an item. Returns the number of characters
+	virtual std::size_t rowPrefix(std::size_t index, char * prefix);
+
+	/// The items are searched with the provider, called from the search thread
+	/// (see Provider)
+	std::shared_ptr<const SearchSource> searchSource() override;
+
+	/// Index of the first visible item
+	std::size_t getTop() const
+	{
+		return top;
+	}
+
+private:
+	/// Move the cursor by delta rows
+	void moveCurrent(long delta);
+	/// Draw the item shown on a row
+	void drawItem(std::size_t row);
+
+	Provider provider;
+	std::size_t count;
+	std::size_t current{};	//< Item under the cursor
+	std::size_t top{};	//< First visible item
+	std::size_t drawnTop{};	//< First item on the screen
+	std::size_t drawnCurrent{};	//< Item highlighted on the screen
+	std::size_t selected = none;
+	chtype choiceCharacter;
+	chtype highlight;
+	/// Buffer receiving the text of the items, reused for each row
+	std::string itemText{};
+	/// Buffer receiving the text of the rows, reused for each row
+	std::string rowText{};
+};
+
+/****************************************************************************//*
+class CdkFuzzyList
+List of items narrowed by a fuzzy filter as the user types (see FuzzyFilter).
+
+The query is typed in a CdkEntry coupled to the list with attach(): after each
+key the list is filtered again, and the up and down keys of the entry move in
+the list. The filtering is done one frame budget at a time, so the visible
+rows are updated within a frame even for millions of items; the ranking by
+score is displayed when the filtering is done.
+
+getItem() gives the index of the item under the cursor, in the items given to
+the constructor.
+
+******************************************************************************/
+class CdkFuzzyList : public CdkVirtualList
+{
+public:
+	/// Constructors
+	CdkFuzzyList(CdkScreen & screen, //< Screen where the widget is located
+			int xrel, //< Relative position from the screen
+			int yrel, //< Relative position from the screen
+			int height, //< Widget height
+			int width, //< Widget width
+			const std::string & title, //< Title displayed at the top of the widget
+			std::size_t count, //< Number of items
+			Provider items, //< Function giving the text of the items
+			chtype highlight = A_REVERSE, //< Attribute of the current item
+			bool box = true
+			);
+
+	/// Destructor
+	~CdkFuzzyList();
+
+	/// Filter the items with a query
+	void setQuery(const std::string & query);
+
+	/// Filter the items with the value of an entry after each key. The call
+	/// back of the entry is replaced
+	void attach(CdkEntry & entry);
+
+	/// Index of the item under the cursor, none if no item matches
+	std::size_t getItem() const;
+
+	/// Maximum time spent filtering per frame
+	void setBudget(std::chrono::nanoseconds duration)
+	{
+		budget = duration;
+	}
+
+	/// True when the filtering of the current query is done
+	bool isFiltered() const
+	{
+		return filter.isDone();
+	}
+
+protected:
+	/// The rows matching the query when the search starts
+	std::shared_ptr<const SearchSource> searchSource() override;
+
+private:
+	/// Filter during one budget and update the list
+	void filterStep();
+	/// Call back of the attached entry
+	int entryKey(CdkWidget & widget, chtype key);
+
+	Provider items;
+	FuzzyFilter filter;
+	std::chrono::nanoseconds budget = std::chrono::milliseconds(8);
+	/// Timer running filterStep once per frame, -1 when none
+	int timer = -1;
+};
+
+/****************************************************************************//*
+class CdkLogTail
+Display of the last lines of a stream of text, such as a log.
+
+The lines are kept in a ring buffer of fixed capacity: appending a line is O(1)
+and does not allocate once the slots have grown to the size of the lines.
+append() can be called from any thread. The widget is redrawn at most once per
+frame and only the new lines are drawn, the others are scrolled. At most one
+screen of lines is drawn per frame whatever the input rate.
+
+The arrow and page keys scroll back in the buffer, End follows the new lines
+again. Enter or Tab exits the widget and Escape cancels it.
+
+******************************************************************************/
+class CdkLogTail : public CursesWidget
+{
+public:
+	/// Constructors
+	CdkLogTail(CdkScreen & screen, //< Screen where the widget is located
+			int xrel, //< Relative position from the screen
+			int yrel, //< Relative position from the screen
+			int height, //< Widget height
+			int width, //< Widget width
+			const std::string & title, //< Title displayed at the top of the widget
+			std::size_t capacity = 10000, //< Number of lines kept
+			bool box = true
+			);
+
+	/// Destructor
+	~CdkLogTail();
+
+	/// Append a line. This can be called from any thread
+	void append(const char * text, std::size_t length);
+	void append(const std::string & line)
+	{
+		append(line.data(), line.size());
+	}
+
+	/// Remove all the lines
+	void clear() override;
+
+	/// Number of lines appended since the creation or the last clear
+	std::uint64_t getCount() const;
+
+	/// Number of lines kept in the buffer
+	std::size_t getCapacity() const
+	{
+		return lines.size();
+	}
+
+protected:
+
+	void renderContent(bool full) override;
+	EExitType processKey(chtype key) override;
+
+private:
+	/// Copy the lines [first, last) to the start of copied and return their
+	/// number. The mutex must be held
+	std::size_t copyLines(std::uint64_t first, std::uint64_t last);
+	/// Scroll back by delta lines (forward if negative)
+	void scrollBack(long delta);
+
+	/// Ring buffer of the lines. Line seq is in slot seq % capacity
+	std::vector<std::string> lines;
+	/// Protect lines and head against the producers
+	mutable std::mutex mutex{};
+	/// Number of lines appended
+	std::uint64_t head{};
+	/// Value of head when the widget was last drawn
+	std::uint64_t drawnHead{};
+	/// Number of lines between the last visible line and the newest line
+	std::uint64_t offset{};
+	/// Lines to draw, copied from the ring buffer under the mutex
+	std::vector<std::string> copied{};
+};
+
+/****************************************************************************//*
+class CdkFileViewer
+Display of a file of any size, such as a multi GB log or capture.
+
+The file is mapped in memory and its lines are indexed by a background thread
+(see LineIndex). The first screen is displayed as soon as it is indexed, and
+the viewer can be paged or moved to any line in O(1) while the indexing goes
+on. Only the visible lines are read from the file.
+
+The arrow and page keys move in the file, Home and End go to the first and to
+the last line indexed. After a search, n and N move to the next and to the
+previous match. Enter or Tab exits the widget and Escape cancels it.
+
+******************************************************************************/
+class CdkFileViewer : public CursesWidget
+{
+public:
+	/// Constructors. Throws std::system_error if the file cannot be mapped
+	CdkFileViewer(CdkScreen & screen, //< Screen where the widget is located
+			int xrel, //< Relative position from the screen
+			int yrel, //< Relative position from the screen
+			int height, //< Widget height
+			int width, //< Widget width
+			const std::string & title, //< Title displayed at the top of the widget
+			const std::string & path, //< File displayed
+			bool box = true
+			);
+
+	/// Destructor
+	~CdkFileViewer();
+
+	/// Number of lines indexed so far
+	std::size_t getLineCount() const
+	{
+		return index.getCount();
+	}
+
+	/// True when the whole file has been indexed
+	bool isIndexed() const
+	{
+		return index.isComplete();
+	}
+
+	/// Index of the first visible line
+	std::size_t getTop() const
+	{
+		return top;
+	}
+
+	/// Display the file from a line. The line is clamped to the lines
+	/// indexed so far
+	void setTop(std::size_t line);
+
+	/// Index of the first visible column
+	std::size_t getLeft() const
+	{
+		return left;
+	}
+
+	/// Scroll the file horizontally
+	void setLeft(std::size_t column);
+
+protected:
+
+	void renderContent(bool full) override;
+	EExitType processKey(chtype key) override;
+	std::shared_ptr<const SearchSource> searchSource() override;
+
+private:
+	/// Called by the indexing thread when lines have been indexed
+	void indexed();
+
+	MappedFile file;
+	std::size_t top{};	//< First visible line
+	std::size_t left{};	//< First visible column
+	std::size_t drawnTop{};	//< First line on the screen
+	/// Number of rows which were drawn with a line, the others were blank
+	std::size_t drawnRows{};
+	/// Index of the lines, last so that its thread stops first
+	LineIndex index;
+};
+
+/****************************************************************************//*
+class CdkNumericReadout
+Display of a number on a single row, with an optional label on its left.
+
+The number is formatted with std::to_chars, right aligned in a field of fixed
+width, into a buffer of the widget: updating the value allocates nothing. The
+widget is only redrawn when the text of the value changes, and only the field
+of the value is written. A value too large for the field is shown as #.
+
+******************************************************************************/
+class CdkNumericReadout : public CursesWidget
+{
+public:
+	/// Constructors
+	CdkNumericReadout(CdkScreen & screen, //< Screen where the widget is located
+			int xrel, //< Relative position from the screen
+			int yrel, //< Relative position from the screen
+			int width, //< Widget width, including the label
+			const std::string & label = "", //< Text displayed before the value
+			int precision = 0, //< Number of decimals of the floating point values
+			bool box = false
+			);
+
+	/// Display an integer
+	template <typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+	void setValue(T value)
+	{
+		auto result = std::to_chars(text, text + field, value);
+		update(result.ptr, result.ec == std::errc());
+	}
+
+	/// Display a floating point value with the precision of the widget
+	void setValue(double value);
+
+	/// Number of decimals of the floating point values
+	void setPrecision(int digits)
+	{
+		precision = digits;
+	}
+
+	/// Number of values which did not change the text displayed
+	std::uint64_t getSkippedUpdates() const
+	{
+		return skipped;
+	}
+
+	/// Size of the buffer of the text, the widest field displayed
+	static constexpr std::size_t maxField = 40;
+
+protected:
+
+	void renderContent(bool full) override;
+	EExitType processKey(chtype key) override;
+
+private:
+	/// Right align the characters written at the start of the buffer and
+	/// redraw if the text has changed
+	void update(char * end, bool ok);
+
+	std::string label;
+	int precision;
+	/// Width of the field of the value
+	std::size_t field;
+	/// Text of the value, field characters
+	char text[maxField]{};
+	/// Text of the value when it was last drawn
+	char drawnText[maxField]{};
+	std::uint64_t skipped = 0;
+};
+
+/****************************************************************************//*
+class CdkEditor
+Multi line text editor, for texts of tens of thousands of lines.
+
+The lines are kept in a gap buffer (see GapBuffer): inserting or removing a
+line next to the previous edit is O(1) and does not move the other lines.
+The editor records the range of lines modified since the last frame and only
+draws them; when the view scrolls by less than a page, the rows are scrolled
+and only the rows which appear are drawn.
+
+Tab inserts spaces up to the next tab stop. Ctrl-X exits the editor and Escape
+cancels it.
+
+******************************************************************************/
+class CdkEditor : public CursesWidget
+{
+public:
+	/// Constructors
+	CdkEditor(CdkScreen & screen, //< Screen where the widget is located
+			int xrel, //< Relative position from the screen
+			int yrel, //< Relative position from the screen
+			int height, //< Widget height
+			int width, //< Widget width
+			const std::string & title, //< Title displayed at the top of the widget
+			bool box = true
+			);
+
+	/// Replace the text. The lines are separated by new lines
+	void setText(const std::string & text);
+
+	/// Get the text, the lines separated by new lines
+	std::string getText() const;
+
+	/// Number of lines, at least one
+	std::size_t getLineCount() const
+	{
+		return lines.size();
+	}
+
+	/// Get a line, without its new line
+	const std::string & getLine(std::size_t line) const
+	{
+		return lines[line];
+	}
+
+	/// Position of the cursor
+	std::size_t getCursorLine() const
+	{
+		return cursorLine;
+	}
+	std::size_t getCursorColumn() const
+	{
+		return cursorColumn;
+	}
+
+	/// Move the cursor. The position is clamped to the text
+	void setCursor(std::size_t line, std::size_t column);
+
+	/// Insert a text at the cursor. It can contain new lines
+	void insert(const std::string & text);
+
+	/// True if the text has been modified since setText or setModified(false)
+	bool isModified() const
+	{
+		return modified;
+	}
+	void setModified(bool value)
+	{
+		modified = value;
+	}
+
+	/// Remove all the text
+	void clear() override
+	{
+		setText("");
+	}
+
+	/// The pasted text is inserted as a single edit
+	EExitType paste(const std::string & text) override
+	{
+		insert(text);
+		// Drawn as inject does after a key
+		draw(boxed);
+		return vEARLY_EXIT;
+	}
+
+	/// Number of columns between two tab stops
+	static constexpr std::size_t tabWidth = 4;
+
+protected:
+
+	void renderContent(bool full) override;
+	EExitType processKey(chtype key) override;
+
+private:
+	/// Add lines to the range of lines to draw
+	void markLines(std::size_t first, std::size_t last);
+	/// Record that a line has been modified
+	void touchLine(std::size_t line);
+	/// Record that the lines from line have been modified or moved
+	void touchFrom(std::size_t line);
+	/// Record that the lines from first, numbered before the edit, have moved
+	/// by delta lines: they are scrolled instead of being drawn again
+	void shiftLines(std::size_t first, long delta);
+	/// Move the cursor and scroll to keep it visible
+	void moveCursor(std::size_t line, std::size_t column);
+	/// Draw a line on a row of the content area
+	void drawLine(int row, std::size_t line);
+	void insertChar(char c);
+	void newLine();
+	void backspace();
+	void deleteChar();
+
+	/// Lines of the text
+	GapBuffer<std::string> lines{};
+	std::size_t cursorLine{};
+	std::size_t cursorColumn{};
+	/// Column the cursor tries to keep when it moves up and down
+	std::size_t goalColumn{};
+	std::size_t top{};	//< First visible line
+	std::size_t left{};	//< First visible column
+	/// First visible line when the widget was last drawn
+	std::size_t drawnTop{};
+	/// Lines modified since the widget was last drawn: [dirtyFirst, dirtyLast)
+	std::size_t dirtyFirst{};
+	std::size_t dirtyLast{};
+	/// Lines moved since the widget was last drawn: the lines which were at
+	/// shiftStart and after are now shiftDelta lines further
+	std::size_t shiftStart{};
+	long shiftDelta{};
+	/// True when the moves cannot be scrolled as one block: all the lines
+	/// from the edits are drawn again
+	bool shiftBroken = false;
+	bool modified = false;
+};
+
+} // end of namespace
+
+#endif
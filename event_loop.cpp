@@ -0,0 +1,154 @@
+#include "event_loop.h"
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <system_error>
+
+namespace
+{
+	// Number of events retrieved by a single epoll_wait
+	constexpr int maxEvents = 32;
+
+	timespec toTimespec(std::chrono::nanoseconds value)
+	{
+		timespec ts{};
+		ts.tv_sec = value.count() / 1000000000;
+		ts.tv_nsec = value.count() % 1000000000;
+		return ts;
+	}
+}
+
+tui::EventLoop::EventLoop()
+{
+	epollFd = epoll_create1(EPOLL_CLOEXEC);
+	if (epollFd < 0)
+		throw std::system_error(errno, std::generic_category(), "epoll_create1");
+}
+
+tui::EventLoop::~EventLoop()
+{
+	for (auto & timer : timers)
+		close(timer.second);
+	close(epollFd);
+}
+
+void tui::EventLoop::addFd(int fd, std::uint32_t events, Handler handler)
+{
+	epoll_event ev{};
+	ev.events = events;
+	ev.data.fd = fd;
+	if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+		throw std::system_error(errno, std::generic_category(), "epoll_ctl");
+	handlers[fd] = std::make_shared<Handler>(std::move(handler));
+}
+
+void tui::EventLoop::modifyFd(int fd, std::uint32_t events)
+{
+	epoll_event ev{};
+	ev.events = events;
+	ev.data.fd = fd;
+	if (epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev) < 0)
+		throw std::system_error(errno, std::generic_category(), "epoll_ctl");
+}
+
+void tui::EventLoop::removeFd(int fd)
+{
+	epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+	handlers.erase(fd);
+}
+
+int tui::EventLoop::addTimer(std::chrono::nanoseconds delay, std::chrono::nanoseconds period, Callback fn)
+{
+	auto fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd < 0)
+		throw std::system_error(errno, std::generic_category(), "timerfd_create");
+	itimerspec spec{};
+	// A zero it_value would disarm the timer
+	spec.it_value = toTimespec(delay.count() > 0 ? delay : std::chrono::nanoseconds(1));
+	spec.it_interval = toTimespec(period);
+	timerfd_settime(fd, 0, &spec, nullptr);
+	bool periodic = period.count() != 0;
+	auto timer = nextTimer++;
+	addFd(fd, EPOLLIN, [this, fd, timer, periodic, fn](std::uint32_t)
+		{
+			std::uint64_t expirations{};
+			if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+				return;
+			if (!periodic)
+				removeTimer(timer);
+			fn();
+		});
+	timers[timer] = fd;
+	return timer;
+}
+
+void tui::EventLoop::removeTimer(int timer)
+{
+	auto pos = timers.find(timer);
+	if (pos == timers.end())
+		return;
+	removeFd(pos->second);
+	close(pos->second);
+	timers.erase(pos);
+}
+
+int tui::EventLoop::addEvent(Callback fn)
+{
+	auto fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (fd < 0)
+		throw std::system_error(errno, std::generic_category(), "eventfd");
+	addFd(fd, EPOLLIN, [fd, fn](std::uint32_t)
+		{
+			std::uint64_t count{};
+			if (read(fd, &count, sizeof(count)) == sizeof(count))
+				fn();
+		});
+	return fd;
+}
+
+void tui::EventLoop::removeEvent(int event)
+{
+	removeFd(event);
+	close(event);
+}
+
+void tui::EventLoop::signal(int event)
+{
+	std::uint64_t one = 1;
+	if (write(event, &one, sizeof(one)) < 0)
+	{
+		// The counter is saturated: the event is already signaled
+	}
+}
+
+int tui::EventLoop::runOnce(std::chrono::milliseconds timeout)
+{
+	epoll_event events[maxEvents];
+	auto ready = epoll_wait(epollFd, events, maxEvents, timeout.count() < 0 ? -1 : static_cast<int>(timeout.count()));
+	if (ready < 0)
+	{
+		if (errno == EINTR)
+			return 0;
+		throw std::system_error(errno, std::generic_category(), "epoll_wait");
+	}
+	int called{};
+	for (int index = 0; index < ready; ++index)
+	{
+		// The handler may have been removed by a previous handler of this batch
+		auto pos = handlers.find(events[index].data.fd);
+		if (pos == handlers.end())
+			continue;
+		auto handler = pos->second;
+		(*handler)(events[index].events);
+		++called;
+	}
+	return called;
+}
+
+void tui::EventLoop::run()
+{
+	running = true;
+	while (running)
+		runOnce();
+}
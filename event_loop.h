@@ -0,0 +1,91 @@
+#ifndef TUI_EVENT_LOOP_H
+#define TUI_EVENT_LOOP_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <sys/epoll.h>
+
+
+namespace tui
+
+{
+
+/***************************************************************************//*
+Event loop based on epoll.
+
+The loop multiplexes file descriptors (stdin, sockets, pipes...), timers
+implemented with timerfd and events implemented with eventfd. When nothing
+happens the loop sleeps in epoll_wait without any periodic wake up.
+
+Handlers can add or remove file descriptors, including their own, while they
+are called.
+
+******************************************************************************/
+class EventLoop
+{
+	public:
+		/// Handler of a file descriptor. It receives the epoll events (EPOLLIN...)
+		using Handler = std::function<void(std::uint32_t events)>;
+		/// Handler of a timer or of an event
+		using Callback = std::function<void()>;
+
+		EventLoop();
+		~EventLoop();
+
+		EventLoop(const EventLoop &) = delete;
+		EventLoop & operator=(const EventLoop &) = delete;
+
+		/// Watch a file descriptor for the given epoll events
+		void addFd(int fd, std::uint32_t events, Handler handler);
+		/// Change the events watched for a file descriptor
+		void modifyFd(int fd, std::uint32_t events);
+		/// Stop watching a file descriptor. The descriptor is not closed
+		void removeFd(int fd);
+
+		/// Call fn after delay, then every period if period is not zero.
+		/// Returns the identifier of the timer. The identifiers are never
+		/// reused
+		int addTimer(std::chrono::nanoseconds delay, std::chrono::nanoseconds period, Callback fn);
+		/// Cancel a timer. Nothing is done if the timer has already been
+		/// removed, or has fired if it is not periodic
+		void removeTimer(int timer);
+
+		/// Create an event which calls fn each time it is signaled. Returns the
+		/// identifier of the event which is given to signal()
+		int addEvent(Callback fn);
+		/// Remove an event
+		void removeEvent(int event);
+		/// Signal an event. This can be called from any thread
+		static void signal(int event);
+
+		/// Wait for at most timeout and call the handlers of the ready file
+		/// descriptors. A negative timeout waits until something happens.
+		/// Returns the number of handlers called
+		int runOnce(std::chrono::milliseconds timeout = std::chrono::milliseconds(-1));
+		/// Run until stop() is called
+		void run();
+		/// Request run() to return
+		void stop()
+		{
+			running = false;
+		}
+
+	private:
+		int epollFd = -1;
+		bool running = false;
+		/// Handlers indexed by file descriptor. They are shared so that a handler
+		/// removed while it runs is only destroyed when it returns
+		std::unordered_map<int, std::shared_ptr<Handler>> handlers{};
+		/// File descriptor of each timer. The timers are not identified by
+		/// their descriptor, which is reused once the timer is closed
+		std::unordered_map<int, int> timers{};
+		/// Identifier of the next timer
+		int nextTimer = 0;
+};
+
+} // end of namespace
+
+#endif
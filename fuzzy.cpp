@@ -0,0 +1,181 @@
+#include "fuzzy.h"
+#include <algorithm>
+
+namespace
+{
+	/// ASCII lower case. The other bytes are not changed
+	inline char lower(char c)
+	{
+		return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+	}
+
+	inline bool isAlnum(char c)
+	{
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+	}
+
+	/// Bit of a character in a mask: letters without case and digits have
+	/// their own bit, the other characters share the remaining ones
+	inline std::uint64_t charBit(char c)
+	{
+		auto u = static_cast<unsigned char>(lower(c));
+		if (u >= 'a' && u <= 'z')
+			return std::uint64_t(1) << (u - 'a');
+		if (u >= '0' && u <= '9')
+			return std::uint64_t(1) << (26 + u - '0');
+		if (u >= 0x80)
+			return std::uint64_t(1) << 63;
+		return std::uint64_t(1) << (36 + u % 27);
+	}
+
+	/// True if the characters of a appear in b in the same order
+	bool isSubsequence(const std::string & a, const std::string & b)
+	{
+		std::size_t i = 0;
+		for (auto c : b)
+			if (i < a.size() && a[i] == c)
+				++i;
+		return i == a.size();
+	}
+}
+
+tui::FuzzyFilter::FuzzyFilter(std::size_t count, Provider provider)
+	: provider(std::move(provider)), masks(count)
+{
+	Level all;
+	all.items.resize(count);
+	for (std::size_t index = 0; index < count; ++index)
+	{
+		text.clear();
+		this->provider(index, text);
+		masks[index] = charMask(text.data(), text.size());
+		all.items[index] = static_cast<std::uint32_t>(index);
+	}
+	all.ranked = all.items;
+	levels.push_back(std::move(all));
+}
+
+std::uint64_t tui::FuzzyFilter::charMask(const char * text, std::size_t length)
+{
+	std::uint64_t mask = 0;
+	for (std::size_t i = 0; i < length; ++i)
+		mask |= charBit(text[i]);
+	return mask;
+}
+
+int tui::FuzzyFilter::score(const char * text, std::size_t length, const std::string & query)
+{
+	auto size = query.size();
+	if (size == 0)
+		return 0;
+	// Forward scan: end of the first match
+	std::size_t matched = 0;
+	std::size_t end = 0;
+	for (std::size_t i = 0; i < length && matched < size; ++i)
+		if (lower(text[i]) == query[matched] && ++matched == size)
+			end = i + 1;
+	if (matched < size)
+		return noMatch;
+	// Backward scan from the end: shortest match ending there
+	auto start = end;
+	while (matched > 0)
+		if (lower(text[--start]) == query[matched - 1])
+			--matched;
+	// Score of the characters of the match
+	int result = 0;
+	int run = 0;
+	for (auto i = start; i < end; ++i)
+	{
+		if (matched < size && lower(text[i]) == query[matched])
+		{
+			result += 16 + 8 * std::min(run, 4);
+			// Start of a word, or upper case letter in camel case
+			if (i == 0 || !isAlnum(text[i - 1]))
+				result += i == 0 ? 20 : 12;
+			else if (text[i] >= 'A' && text[i] <= 'Z' && text[i - 1] >= 'a' && text[i - 1] <= 'z')
+				result += 10;
+			++run;
+			++matched;
+		}
+		else
+		{
+			run = 0;
+			result -= 2;
+		}
+	}
+	// Matches far from the start of the item come last
+	result -= static_cast<int>(std::min<std::size_t>(start, 64) / 4);
+	return std::max(0, std::min(result, scoreLevels - 1));
+}
+
+bool tui::FuzzyFilter::setQuery(const std::string & newQuery)
+{
+	std::string folded(newQuery);
+	for (auto & c : folded)
+		c = lower(c);
+	if (folded == query)
+		return false;
+	// A match of the new query matches all the queries which are a
+	// subsequence of it: the search starts from the last of them
+	while (levels.size() > 1 && !isSubsequence(levels.back().query, folded))
+		levels.pop_back();
+	query = std::move(folded);
+	matched.clear();
+	position = 0;
+	done = levels.back().query == query;
+	queryMask = charMask(query.data(), query.size());
+	return true;
+}
+
+bool tui::FuzzyFilter::step(std::chrono::nanoseconds budget)
+{
+	if (done)
+		return true;
+	auto deadline = std::chrono::steady_clock::now() + budget;
+	auto & candidates = levels.back().items;
+	while (position < candidates.size())
+	{
+		auto index = candidates[position++];
+		// Most of the items are rejected here without reading their text
+		if ((masks[index] & queryMask) == queryMask)
+		{
+			text.clear();
+			provider(index, text);
+			auto value = score(text.data(), text.size(), query);
+			if (value != noMatch)
+				matched.push_back({index, static_cast<std::uint16_t>(value)});
+		}
+		if ((position & 1023) == 0 && std::chrono::steady_clock::now() >= deadline)
+			return false;
+	}
+	finish();
+	return true;
+}
+
+void tui::FuzzyFilter::finish()
+{
+	// Counting sort by decreasing score. It is stable, so the items of the same
+	// score stay in increasing order
+	std::vector<std::size_t> first(scoreLevels + 1, 0);
+	for (auto & match : matched)
+		++first[scoreLevels - match.score];
+	std::size_t total = 0;
+	for (auto & bucket : first)
+	{
+		auto count = bucket;
+		bucket = total;
+		total += count;
+	}
+	Level level;
+	level.query = query;
+	level.items.reserve(matched.size());
+	level.ranked.resize(matched.size());
+	for (auto & match : matched)
+	{
+		level.items.push_back(match.index);
+		level.ranked[first[scoreLevels - match.score]++] = match.index;
+	}
+	levels.push_back(std::move(level));
+	matched.clear();
+	done = true;
+}
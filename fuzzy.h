@@ -0,0 +1,130 @@
+#ifndef TUI_FUZZY_H
+#define TUI_FUZZY_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+
+namespace tui
+
+{
+
+/***************************************************************************//*
+Fuzzy filter of a list of items.
+
+An item matches a query when the characters of the query appear in the item in
+the same order, ignoring the case. The matches are ranked by a score which
+favours consecutive characters and the starts of words.
+
+The filter is incremental. When a character is added to the query, only the
+items which matched the previous query are examined, and the results of the
+shorter queries are kept so that erasing a character is immediate. Each item
+has a 64 bit mask of the characters it contains, so most of the items are
+rejected with a single AND, without reading their text. The items passing the
+mask are scored by a scalar loop over their text.
+
+The filtering is done by step(), which stops after a time budget and resumes
+where it stopped at the next call. The matches found so far can be displayed
+between two steps; they are ranked when the filtering is done.
+
+******************************************************************************/
+class FuzzyFilter
+{
+	public:
+		/// Function writing in text the item at index. The text is empty
+		/// when the function is called
+		using Provider = std::function<void(std::size_t index, std::string & text)>;
+
+		/// Score of an item which does not match
+		static constexpr int noMatch = -1;
+
+		/// Constructors. The masks of all the items are computed
+		FuzzyFilter(std::size_t count, Provider provider);
+
+		/// Change the query. The filtering is done by the next calls to step().
+		/// Returns false if the query has not changed
+		bool setQuery(const std::string & query);
+
+		/// Get the current query
+		const std::string & getQuery() const
+		{
+			return query;
+		}
+
+		/// Filter the items until the budget is spent. Returns true when the
+		/// filtering is done
+		bool step(std::chrono::nanoseconds budget);
+
+		/// True when all the items have been filtered for the current query
+		bool isDone() const
+		{
+			return done;
+		}
+
+		/// Number of matches, so far if the filtering is not done
+		std::size_t getCount() const
+		{
+			return done ? levels.back().ranked.size() : matched.size();
+		}
+
+		/// Index of the item of a match. When the filtering is done, the
+		/// matches are sorted by decreasing score
+		std::size_t getItem(std::size_t rank) const
+		{
+			return done ? levels.back().ranked[rank] : matched[rank].index;
+		}
+
+		/// Mask of the characters of a text
+		static std::uint64_t charMask(const char * text, std::size_t length);
+
+		/// Score of a text for a query in lower case. Returns noMatch if the
+		/// text does not match
+		static int score(const char * text, std::size_t length, const std::string & query);
+
+	private:
+		/// Number of values of a score, used to sort the matches
+		static constexpr int scoreLevels = 1024;
+
+		struct Match
+		{
+			std::uint32_t index;
+			std::uint16_t score;
+		};
+
+		/// Result of a query which has been filtered completely
+		struct Level
+		{
+			std::string query;
+			/// Items matching, in increasing order
+			std::vector<std::uint32_t> items;
+			/// Items matching, by decreasing score
+			std::vector<std::uint32_t> ranked;
+		};
+
+		/// Sort the matches by score and store the new level
+		void finish();
+
+		Provider provider;
+		/// Mask of the characters of each item
+		std::vector<std::uint64_t> masks;
+		std::string query;
+		std::uint64_t queryMask = 0;
+		/// Results of the queries which are a subsequence of the current one.
+		/// The first level is the empty query
+		std::vector<Level> levels;
+		/// Matches of the current pass, in the order of the candidates
+		std::vector<Match> matched;
+		/// Position of the next candidate in the last level
+		std::size_t position = 0;
+		bool done = true;
+		/// Text of the item being scored, reused for each item
+		std::string text;
+};
+
+} // end of namespace
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef TUI_GAP_BUFFER_H
+#define TUI_GAP_BUFFER_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+
+namespace tui
+
+{
+
+/***************************************************************************//*
+Sequence with a gap of free elements at the place of the last edit.
+
+Inserting or erasing at the gap is O(1) amortized. Editing elsewhere moves the
+gap first, which costs the distance between the two places: the edits of a
+text editor are mostly next to each other, so they rarely move it far.
+Elements are moved, never copied, when the gap moves or grows.
+
+******************************************************************************/
+template <typename T>
+class GapBuffer
+{
+public:
+	GapBuffer() = default;
+
+	/// Number of elements
+	std::size_t size() const
+	{
+		return buffer.size() - (gapEnd - gapStart);
+	}
+
+	bool empty() const
+	{
+		return size() == 0;
+	}
+
+	T & operator[](std::size_t index)
+	{
+		return buffer[index < gapStart ? index : index + gapEnd - gapStart];
+	}
+
+	const T & operator[](std::size_t index) const
+	{
+		return buffer[index < gapStart ? index : index + gapEnd - gapStart];
+	}
+
+	/// Insert an element before index
+	void insert(std::size_t index, T value)
+	{
+		assert(index <= size());
+		if (gapStart == gapEnd)
+			grow();
+		moveGap(index);
+		buffer[gapStart++] = std::move(value);
+	}
+
+	/// Erase the element at index
+	void erase(std::size_t index)
+	{
+		assert(index < size());
+		moveGap(index);
+		// The element goes into the gap, its resources are released
+		buffer[gapEnd++] = T();
+	}
+
+	/// Remove all the elements
+	void clear()
+	{
+		buffer.clear();
+		gapStart = 0;
+		gapEnd = 0;
+	}
+
+private:
+	/// Move the gap so that it starts at index
+	void moveGap(std::size_t index)
+	{
+		// An empty gap moves without moving the elements, which would be
+		// moved onto themselves
+		if (gapStart == gapEnd)
+		{
+			gapStart = gapEnd = index;
+			return;
+		}
+		if (index < gapStart)
+		{
+			auto count = gapStart - index;
+			std::move_backward(buffer.begin() + index, buffer.begin() + gapStart, buffer.begin() + gapEnd);
+			gapStart -= count;
+			gapEnd -= count;
+		}
+		else if (index > gapStart)
+		{
+			auto count = index - gapStart;
+			std::move(buffer.begin() + gapEnd, buffer.begin() + gapEnd + count, buffer.begin() + gapStart);
+			gapStart += count;
+			gapEnd += count;
+		}
+	}
+
+	/// Double the capacity, the new space going to the gap
+	void grow()
+	{
+		auto oldSize = buffer.size();
+		auto added = std::max<std::size_t>(oldSize, 16);
+		buffer.resize(oldSize + added);
+		// The elements after the gap move to the end
+		std::move_backward(buffer.begin() + gapEnd, buffer.begin() + oldSize, buffer.end());
+		gapEnd += added;
+	}
+
+	std::vector<T> buffer{};
+	std::size_t gapStart = 0;
+	std::size_t gapEnd = 0;
+};
+
+} // end of namespace
+
+#endif
@@ -0,0 +1,297 @@
+#include "headless.h"
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <stdexcept>
+#include <system_error>
+
+namespace
+{
+	/// Length of a row without its trailing spaces
+	std::size_t trimmedLength(const std::string & row)
+	{
+		auto end = row.find_last_not_of(' ');
+		return end == std::string::npos ? 0 : end + 1;
+	}
+
+	/// Character shown in a frame for a cell of curscr
+	char cellChar(chtype cell)
+	{
+		auto c = static_cast<char>(cell & A_CHARTEXT);
+		if ((cell & A_ALTCHARSET) == 0)
+			return c;
+		switch (c)
+		{
+			case 'q':
+				return '-';
+			case 'x':
+				return '|';
+			case 'l': case 'k': case 'j': case 'm':
+			case 't': case 'u': case 'v': case 'w': case 'n':
+				return '+';
+			default:
+				return c;
+		}
+	}
+}
+
+/******************************************************************************
+
+  Headless Terminal
+
+******************************************************************************/
+
+tui::HeadlessTerminal::HeadlessTerminal(int rows, int cols, const char * type)
+{
+	// Close what has been opened so far
+	auto release = [this]()
+	{
+		if (input != nullptr)
+			std::fclose(input);
+		if (output != nullptr)
+			std::fclose(output);
+		for (auto fd : {slave, master, stopFd})
+			if (fd >= 0)
+				close(fd);
+	};
+	auto fail = [&release](const char * what)
+	{
+		auto error = errno;
+		release();
+		throw std::system_error(error, std::generic_category(), what);
+	};
+
+	master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+	if (master < 0)
+		fail("posix_openpt");
+	char name[64];
+	if (grantpt(master) < 0 || unlockpt(master) < 0 || ptsname_r(master, name, sizeof(name)) != 0)
+		fail("ptsname");
+	slave = open(name, O_RDWR | O_NOCTTY | O_CLOEXEC);
+	if (slave < 0)
+		fail(name);
+	// Size seen by curses when it starts
+	struct winsize size{};
+	size.ws_row = static_cast<unsigned short>(rows);
+	size.ws_col = static_cast<unsigned short>(cols);
+	if (ioctl(master, TIOCSWINSZ, &size) < 0 || fcntl(master, F_SETFL, O_NONBLOCK) < 0)
+		fail("pseudo terminal setup");
+	stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (stopFd < 0)
+		fail("eventfd");
+	// The streams have their own descriptors, the slave stays open for epoll
+	auto inputFd = fcntl(slave, F_DUPFD_CLOEXEC, 0);
+	if (inputFd < 0 || (input = fdopen(inputFd, "r")) == nullptr)
+		fail("fdopen");
+	auto outputFd = fcntl(slave, F_DUPFD_CLOEXEC, 0);
+	if (outputFd < 0 || (output = fdopen(outputFd, "w")) == nullptr)
+		fail("fdopen");
+
+	// The output is read before curses starts, it must never block on a full
+	// pseudo terminal
+	reader = std::thread(&HeadlessTerminal::readOutput, this);
+	screen = newterm(type, output, input);
+	if (screen == nullptr)
+	{
+		std::uint64_t one = 1;
+		(void)write(stopFd, &one, sizeof(one));
+		reader.join();
+		release();
+		throw std::runtime_error(std::string("unknown terminal type ") + type);
+	}
+	set_term(screen);
+	// LINES and COLUMNS in the environment override the size of the terminal
+	if (LINES != rows || COLS != cols)
+		resizeterm(rows, cols);
+}
+
+tui::HeadlessTerminal::~HeadlessTerminal()
+{
+	set_term(screen);
+	if (!isendwin())
+		endwin();
+	delscreen(screen);
+	// The output of endwin is read before the thread stops
+	sync();
+	std::uint64_t one = 1;
+	(void)write(stopFd, &one, sizeof(one));
+	reader.join();
+	std::fclose(input);
+	std::fclose(output);
+	close(slave);
+	close(master);
+	close(stopFd);
+}
+
+void tui::HeadlessTerminal::sendInput(const std::string & keys)
+{
+	std::size_t done = 0;
+	while (done < keys.size())
+	{
+		auto written = write(master, keys.data() + done, keys.size() - done);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			// The master is non blocking: wait until the application reads
+			if (errno != EAGAIN)
+				throw std::system_error(errno, std::generic_category(), "sendInput");
+			pollfd fd{master, POLLOUT, 0};
+			poll(&fd, 1, -1);
+			continue;
+		}
+		done += static_cast<std::size_t>(written);
+	}
+}
+
+std::uint64_t tui::HeadlessTerminal::sync()
+{
+	// The output of the last doupdate has been written to the slave side when
+	// it returned: reading the master until it is empty gets all of it
+	std::lock_guard<std::mutex> lock(mutex);
+	drain();
+	return bytes;
+}
+
+tui::HeadlessTerminal::Frame tui::HeadlessTerminal::snapshot() const
+{
+	int rows;
+	int cols;
+	getmaxyx(curscr, rows, cols);
+	// The cursor of curscr is the one of the terminal, it is put back
+	int cursorY;
+	int cursorX;
+	getyx(curscr, cursorY, cursorX);
+	Frame frame(static_cast<std::size_t>(rows));
+	std::vector<chtype> cells(static_cast<std::size_t>(cols) + 1);
+	for (int row = 0; row < rows; ++row)
+	{
+		auto count = mvwinchnstr(curscr, row, 0, cells.data(), cols);
+		auto & text = frame[static_cast<std::size_t>(row)];
+		text.reserve(static_cast<std::size_t>(cols));
+		for (int col = 0; col < count; ++col)
+			text += cellChar(cells[static_cast<std::size_t>(col)]);
+	}
+	wmove(curscr, cursorY, cursorX);
+	return frame;
+}
+
+tui::HeadlessTerminal::FrameStats tui::HeadlessTerminal::measure(const std::function<void()> & draw)
+{
+	FrameStats stats;
+	auto before = sync();
+	auto start = std::chrono::steady_clock::now();
+	draw();
+	doupdate();
+	stats.bytes = sync() - before;
+	stats.duration = std::chrono::steady_clock::now() - start;
+	return stats;
+}
+
+int tui::HeadlessTerminal::compare(const Frame & frame, const Frame & golden)
+{
+	// The trailing spaces are not significant, the text editors remove them
+	// from the golden files
+	auto rows = std::max(frame.size(), golden.size());
+	for (std::size_t row = 0; row < rows; ++row)
+	{
+		static const std::string empty;
+		auto & a = row < frame.size() ? frame[row] : empty;
+		auto & b = row < golden.size() ? golden[row] : empty;
+		auto length = trimmedLength(a);
+		if (length != trimmedLength(b) || a.compare(0, length, b, 0, length) != 0)
+			return static_cast<int>(row);
+	}
+	return -1;
+}
+
+void tui::HeadlessTerminal::save(const Frame & frame, const std::string & path)
+{
+	auto stream = std::fopen(path.c_str(), "w");
+	if (stream == nullptr)
+		throw std::system_error(errno, std::generic_category(), path);
+	bool ok = true;
+	for (auto & row : frame)
+	{
+		auto length = trimmedLength(row);
+		ok = ok && std::fwrite(row.data(), 1, length, stream) == length && std::fputc('\n', stream) != EOF;
+	}
+	auto error = errno;
+	if (std::fclose(stream) != 0 && ok)
+	{
+		error = errno;
+		ok = false;
+	}
+	if (!ok)
+		throw std::system_error(error, std::generic_category(), path);
+}
+
+tui::HeadlessTerminal::Frame tui::HeadlessTerminal::load(const std::string & path)
+{
+	auto stream = std::fopen(path.c_str(), "r");
+	if (stream == nullptr)
+		throw std::system_error(errno, std::generic_category(), path);
+	Frame frame;
+	std::string row;
+	int c;
+	while ((c = std::fgetc(stream)) != EOF)
+	{
+		if (c == '\n')
+		{
+			frame.push_back(std::move(row));
+			row.clear();
+		}
+		else
+			row += static_cast<char>(c);
+	}
+	if (!row.empty())
+		frame.push_back(std::move(row));
+	auto error = std::ferror(stream) ? errno : 0;
+	std::fclose(stream);
+	if (error != 0)
+		throw std::system_error(error, std::generic_category(), path);
+	return frame;
+}
+
+void tui::HeadlessTerminal::readOutput()
+{
+	pollfd fds[2] = {{master, POLLIN, 0}, {stopFd, POLLIN, 0}};
+	for (;;)
+	{
+		if (poll(fds, 2, -1) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+		if (fds[1].revents != 0)
+			return;
+		if (fds[0].revents & POLLIN)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			drain();
+		}
+		else if (fds[0].revents != 0)
+			return;
+	}
+}
+
+void tui::HeadlessTerminal::drain()
+{
+	char buffer[4096];
+	for (;;)
+	{
+		auto count = read(master, buffer, sizeof(buffer));
+		if (count > 0)
+			bytes += static_cast<std::uint64_t>(count);
+		else if (count < 0 && errno == EINTR)
+			continue;
+		else
+			return;
+	}
+}
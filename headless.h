@@ -0,0 +1,113 @@
+#ifndef TUI_HEADLESS_H
+#define TUI_HEADLESS_H
+
+#include <cdk_test.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace tui
+
+{
+
+/***************************************************************************//*
+Terminal without a human in front of it, for the tests and the benchmarks.
+
+A pseudo terminal is opened and curses is started on its slave side with
+newterm, so the application runs unchanged: the output is the one a real
+terminal would receive. A thread reads the master side and counts the bytes.
+
+The frames are read back from curscr, the image curses keeps of the terminal.
+A frame is one string per row; the line drawing characters are shown as '+',
+'-' and '|' so that the golden frames are plain text files.
+
+******************************************************************************/
+class HeadlessTerminal
+{
+	public:
+		/// Rows of the screen, without the attributes
+		using Frame = std::vector<std::string>;
+
+		/// Cost of a frame
+		struct FrameStats
+		{
+			std::chrono::nanoseconds duration{};
+			/// Bytes sent to the terminal
+			std::uint64_t bytes{};
+		};
+
+		/// Open the pseudo terminal and start curses on it. The new screen
+		/// becomes the current one. Throws std::system_error if the pseudo
+		/// terminal cannot be opened and std::runtime_error if the terminal
+		/// type is unknown
+		HeadlessTerminal(int rows, int cols, const char * type = "xterm-256color");
+		~HeadlessTerminal();
+
+		HeadlessTerminal(const HeadlessTerminal &) = delete;
+		HeadlessTerminal & operator=(const HeadlessTerminal &) = delete;
+
+		/// File descriptor from which curses reads the keys
+		int getInputFd() const
+		{
+			return slave;
+		}
+
+		/// File descriptor to which curses writes the output
+		int getOutputFd() const
+		{
+			return slave;
+		}
+
+		/// Send keys to the application, as if they were typed
+		void sendInput(const std::string & keys);
+
+		/// Wait until the output written so far has been read, then return the
+		/// number of bytes sent to the terminal since it was opened
+		std::uint64_t sync();
+
+		/// Content of the terminal as displayed by the last doupdate
+		Frame snapshot() const;
+
+		/// Run draw, send the result to the terminal with doupdate and measure
+		/// the time until the output has been read
+		FrameStats measure(const std::function<void()> & draw);
+
+		/// Index of the first row differing between two frames, -1 if they
+		/// are equal
+		static int compare(const Frame & frame, const Frame & golden);
+
+		/// Save a frame to a text file. Throws std::system_error on failure
+		static void save(const Frame & frame, const std::string & path);
+
+		/// Load a frame saved by save(). Throws std::system_error on failure
+		static Frame load(const std::string & path);
+
+	private:
+		/// Function of the thread reading the master side
+		void readOutput();
+		/// Read the master side until it is empty. The mutex must be held
+		void drain();
+
+		int master = -1;
+		int slave = -1;
+		/// Signaled to stop the thread
+		int stopFd = -1;
+		FILE * input = nullptr;
+		FILE * output = nullptr;
+		SCREEN * screen = nullptr;
+		/// Held while the master side is read, so that sync() knows that no
+		/// byte is being counted
+		std::mutex mutex{};
+		std::uint64_t bytes = 0;
+		std::thread reader{};
+};
+
+} // end of namespace
+
+#endif
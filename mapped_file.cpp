@@ -0,0 +1,160 @@
+#include "mapped_file.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+/******************************************************************************
+
+  Mapped File
+
+******************************************************************************/
+
+tui::MappedFile::MappedFile(const std::string & path)
+{
+	auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw std::system_error(errno, std::generic_category(), path);
+	struct stat info{};
+	if (fstat(fd, &info) < 0)
+	{
+		auto error = errno;
+		close(fd);
+		throw std::system_error(error, std::generic_category(), path);
+	}
+	length = static_cast<std::size_t>(info.st_size);
+	if (length != 0)
+	{
+		auto address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (address == MAP_FAILED)
+		{
+			auto error = errno;
+			close(fd);
+			throw std::system_error(error, std::generic_category(), path);
+		}
+		base = static_cast<const char *>(address);
+	}
+	// The mapping stays valid once the file is closed
+	close(fd);
+}
+
+tui::MappedFile::~MappedFile()
+{
+	if (base != nullptr)
+		munmap(const_cast<char *>(base), length);
+}
+
+void tui::MappedFile::advise(std::size_t offset, std::size_t count, int advice) const
+{
+	if (base == nullptr || offset >= length)
+		return;
+	static const auto pageSize = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+	auto first = offset / pageSize * pageSize;
+	auto last = std::min(offset + count, length);
+	madvise(const_cast<char *>(base) + first, last - first, advice);
+}
+
+void tui::MappedFile::adviseSequential(std::size_t offset, std::size_t count) const
+{
+	advise(offset, count, MADV_SEQUENTIAL);
+}
+
+void tui::MappedFile::release(std::size_t offset, std::size_t count) const
+{
+	advise(offset, count, MADV_DONTNEED);
+}
+
+/******************************************************************************
+
+  Line Index
+
+******************************************************************************/
+
+tui::LineIndex::LineIndex(const MappedFile & file, Progress progress)
+	: file(file), progress(std::move(progress))
+{
+	// A file of n bytes has at most n lines
+	auto maxBlocks = file.size() / blockSize + 1;
+	blocks.reset(new std::unique_ptr<std::uint64_t[]>[maxBlocks]);
+	thread = std::thread(&LineIndex::scan, this);
+}
+
+tui::LineIndex::~LineIndex()
+{
+	stopRequested = true;
+	thread.join();
+}
+
+std::size_t tui::LineIndex::getCount() const
+{
+	// The last line stored ends at the next start, unknown until the file is
+	// completely indexed
+	auto done = isComplete();
+	auto count = published.load(std::memory_order_acquire);
+	if (done || count == 0)
+		return count;
+	return count - 1;
+}
+
+void tui::LineIndex::getLine(std::size_t n, const char *& text, std::size_t & length) const
+{
+	auto count = published.load(std::memory_order_acquire);
+	auto begin = start(n);
+	std::uint64_t end = n + 1 < count ? start(n + 1) - 1 : file.size();
+	// The last line may or may not end with a new line
+	if (n + 1 >= count && end > begin && file.data()[end - 1] == '\n')
+		--end;
+	text = file.data() + begin;
+	length = static_cast<std::size_t>(end - begin);
+}
+
+void tui::LineIndex::push(std::uint64_t offset)
+{
+	auto block = stored >> blockShift;
+	if ((stored & (blockSize - 1)) == 0)
+		blocks[block].reset(new std::uint64_t[blockSize]);
+	blocks[block][stored & (blockSize - 1)] = offset;
+	++stored;
+}
+
+void tui::LineIndex::scan()
+{
+	auto data = file.data();
+	auto size = file.size();
+	if (size != 0)
+		push(0);
+	file.adviseSequential(0, size);
+	// The first chunk is small so that the first screen is displayed at once
+	std::size_t chunk = 64 * 1024;
+	std::size_t position = 0;
+	while (position < size && !stopRequested.load(std::memory_order_relaxed))
+	{
+		auto end = std::min(position + chunk, size);
+		auto cursor = data + position;
+		auto limit = data + end;
+		// memchr is vectorized by the C library
+		while (auto found = static_cast<const char *>(std::memchr(cursor, '\n', limit - cursor)))
+		{
+			cursor = found + 1;
+			if (cursor != data + size)
+				push(static_cast<std::uint64_t>(cursor - data));
+			if (cursor == limit)
+				break;
+		}
+		published.store(stored, std::memory_order_release);
+		file.release(position, end - position);
+		position = end;
+		chunk = std::min<std::size_t>(chunk * 2, 4 * 1024 * 1024);
+		if (progress)
+			progress();
+	}
+	if (stopRequested.load(std::memory_order_relaxed))
+		return;
+	complete.store(true, std::memory_order_release);
+	if (progress)
+		progress();
+}
@@ -0,0 +1,131 @@
+#ifndef TUI_MAPPED_FILE_H
+#define TUI_MAPPED_FILE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+
+namespace tui
+
+{
+
+/***************************************************************************//*
+Read only file mapped in memory.
+
+The file is mapped once and is never read into a buffer: only the pages which
+are accessed are loaded by the kernel, and they can be dropped again with
+release(). An empty file has no mapping and data() returns nullptr.
+
+******************************************************************************/
+class MappedFile
+{
+	public:
+		/// Map a file. Throws std::system_error if it cannot be opened or mapped
+		explicit MappedFile(const std::string & path);
+		~MappedFile();
+
+		MappedFile(const MappedFile &) = delete;
+		MappedFile & operator=(const MappedFile &) = delete;
+
+		const char * data() const
+		{
+			return base;
+		}
+
+		std::size_t size() const
+		{
+			return length;
+		}
+
+		/// Hint that the pages of a range will be read sequentially
+		void adviseSequential(std::size_t offset, std::size_t count) const;
+
+		/// Drop the pages of a range from the memory of the process. They are
+		/// loaded again from the file if they are accessed later
+		void release(std::size_t offset, std::size_t count) const;
+
+	private:
+		/// Apply madvise to the pages fully or partly covered by the range
+		void advise(std::size_t offset, std::size_t count, int advice) const;
+
+		const char * base = nullptr;
+		std::size_t length = 0;
+};
+
+/***************************************************************************//*
+Index of the lines of a mapped file, built by a background thread.
+
+The thread scans the file with memchr and stores the offset of the start of
+each line in blocks of fixed size. The blocks are never moved, so the curses
+thread reads the index while it grows without any lock: the number of lines
+is published with a release store once their offsets are written. Finding
+line n is O(1) at any time.
+
+The scanned pages are released behind the thread, so the memory used is the
+index (8 bytes per line) and not the file. The progress function is called by
+the thread each time a chunk has been indexed, and once more at the end.
+
+******************************************************************************/
+class LineIndex
+{
+	public:
+		/// Function called by the indexing thread when lines have been added
+		using Progress = std::function<void()>;
+
+		/// Start indexing the file
+		LineIndex(const MappedFile & file, Progress progress = nullptr);
+		/// Stop the indexing thread
+		~LineIndex();
+
+		LineIndex(const LineIndex &) = delete;
+		LineIndex & operator=(const LineIndex &) = delete;
+
+		/// Number of lines which can be read. It grows while the file is indexed
+		std::size_t getCount() const;
+
+		/// True when the whole file has been indexed
+		bool isComplete() const
+		{
+			return complete.load(std::memory_order_acquire);
+		}
+
+		/// Get the line n, without the end of line. n must be below getCount()
+		void getLine(std::size_t n, const char *& text, std::size_t & length) const;
+
+	private:
+		/// Number of offsets per block
+		static constexpr std::size_t blockShift = 16;
+		static constexpr std::size_t blockSize = std::size_t(1) << blockShift;
+
+		/// Body of the indexing thread
+		void scan();
+		/// Store the offset of the start of a line
+		void push(std::uint64_t offset);
+		/// Offset of the start of line n. n must be below starts
+		std::uint64_t start(std::size_t n) const
+		{
+			return blocks[n >> blockShift][n & (blockSize - 1)];
+		}
+
+		const MappedFile & file;
+		Progress progress;
+		/// Directory of the blocks, allocated for the largest possible number
+		/// of lines so that it never moves
+		std::unique_ptr<std::unique_ptr<std::uint64_t[]>[]> blocks;
+		/// Number of offsets stored, only accessed by the indexing thread
+		std::size_t stored = 0;
+		/// Number of offsets visible to the other threads
+		std::atomic<std::size_t> published{0};
+		std::atomic<bool> complete{false};
+		std::atomic<bool> stopRequested{false};
+		std::thread thread;
+};
+
+} // end of namespace
+
+#endif
@@ -0,0 +1,92 @@
+#include "output_meter.h"
+#include <cdk_test.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include <system_error>
+
+namespace
+{
+	/// Value of a field of /proc/.../io, 0 if it is missing
+	std::uint64_t ioField(const char * text, const char * name)
+	{
+		auto position = std::strstr(text, name);
+		if (position == nullptr)
+			return 0;
+		return std::strtoull(position + std::strlen(name), nullptr, 10);
+	}
+}
+
+/******************************************************************************
+
+  Output Meter
+
+******************************************************************************/
+
+tui::OutputMeter::OutputMeter(bool perWidget)
+	: perWidget(perWidget)
+{
+	fd = open("/proc/thread-self/io", O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw std::system_error(errno, std::generic_category(), "/proc/thread-self/io");
+	start = readKernel();
+}
+
+tui::OutputMeter::~OutputMeter()
+{
+	close(fd);
+}
+
+tui::OutputCounters tui::OutputMeter::readKernel() const
+{
+	// The file is generated again at each read from the start
+	char text[512];
+	auto length = pread(fd, text, sizeof(text) - 1, 0);
+	if (length < 0)
+		return OutputCounters{};
+	text[length] = '\0';
+	return OutputCounters{ioField(text, "wchar:"), ioField(text, "syscw:"), 0};
+}
+
+tui::OutputCounters tui::OutputMeter::read() const
+{
+	auto output = readKernel() - start;
+	output.flushes = flushes;
+	return output;
+}
+
+void tui::OutputMeter::update()
+{
+	doupdate();
+	++flushes;
+}
+
+void tui::OutputMeter::addFrame(const OutputCounters & output)
+{
+	++frames;
+	frameOutput += output;
+	largestFrame = std::max(largestFrame, output.bytes);
+}
+
+void tui::OutputMeter::addWidget(const std::string & kind, const OutputCounters & output)
+{
+	auto & widget = widgets[kind];
+	++widget.redraws;
+	widget.output += output;
+}
+
+void tui::OutputMeter::dump(std::FILE * stream) const
+{
+	auto total = read();
+	std::fprintf(stream, "output: %" PRIu64 " bytes, %" PRIu64 " writes, %" PRIu64 " flushes\n",
+			total.bytes, total.writes, total.flushes);
+	std::fprintf(stream, "frames: %" PRIu64 ", %" PRIu64 " bytes, %" PRIu64 " writes, largest %" PRIu64 " bytes\n",
+			frames, frameOutput.bytes, frameOutput.writes, largestFrame);
+	for (auto & widget : widgets)
+		std::fprintf(stream, "widget %s: %" PRIu64 " redraws, %" PRIu64 " bytes, %" PRIu64 " writes\n",
+				widget.first.c_str(), widget.second.redraws, widget.second.output.bytes, widget.second.output.writes);
+}
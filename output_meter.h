@@ -0,0 +1,127 @@
+#ifndef TUI_OUTPUT_METER_H
+#define TUI_OUTPUT_METER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+
+
+namespace tui
+
+{
+
+/// Output sent to the terminal
+struct OutputCounters
+{
+	std::uint64_t bytes = 0;
+	/// write system calls
+	std::uint64_t writes = 0;
+	/// Terminal updates (doupdate) issued by the library
+	std::uint64_t flushes = 0;
+
+	OutputCounters & operator+=(const OutputCounters & other)
+	{
+		bytes += other.bytes;
+		writes += other.writes;
+		flushes += other.flushes;
+		return *this;
+	}
+
+	OutputCounters operator-(const OutputCounters & other) const
+	{
+		return OutputCounters{bytes - other.bytes, writes - other.writes, flushes - other.flushes};
+	}
+};
+
+/***************************************************************************//*
+Accounting of the bytes and of the write system calls sent to the terminal.
+
+curses writes its buffer to the file descriptor of the terminal directly, not
+through the FILE given to newterm, so the output is measured where it is
+certain to be seen: the counters kept by the kernel for the curses thread
+(/proc/thread-self/io). The meter must be created by the curses thread, and
+everything this thread writes is counted.
+
+The scheduler records each frame and, in the per widget mode, the screens send
+each widget to the terminal on its own to measure it. This costs a terminal
+update per widget, so the per widget mode is only meant to find the widgets
+which are expensive on the wire.
+
+******************************************************************************/
+class OutputMeter
+{
+	public:
+		/// Start counting the output of the calling thread. Throws
+		/// std::system_error if the counters of the kernel are not available
+		explicit OutputMeter(bool perWidget = false);
+		~OutputMeter();
+
+		OutputMeter(const OutputMeter &) = delete;
+		OutputMeter & operator=(const OutputMeter &) = delete;
+
+		/// True when each widget redraw is measured
+		bool isPerWidget() const
+		{
+			return perWidget;
+		}
+
+		/// Output of the thread since the creation of the meter
+		OutputCounters read() const;
+
+		/// Call doupdate and count the flush
+		void update();
+
+		/// Record the output of a frame
+		void addFrame(const OutputCounters & output);
+
+		/// Record the output of a widget redraw. kind is the type of widget
+		void addWidget(const std::string & kind, const OutputCounters & output);
+
+		/// Number of frames recorded
+		std::uint64_t getFrames() const
+		{
+			return frames;
+		}
+
+		/// Output of all the frames recorded
+		const OutputCounters & getFrameOutput() const
+		{
+			return frameOutput;
+		}
+
+		/// Output of the largest frame
+		std::uint64_t getLargestFrame() const
+		{
+			return largestFrame;
+		}
+
+		/// Print the counters, one line per item
+		void dump(std::FILE * stream) const;
+
+	private:
+		/// Counters of the thread since it started
+		OutputCounters readKernel() const;
+
+		struct WidgetOutput
+		{
+			std::uint64_t redraws = 0;
+			OutputCounters output{};
+		};
+
+		/// /proc/thread-self/io of the curses thread
+		int fd = -1;
+		bool perWidget;
+		/// Kernel counters when the meter was created
+		OutputCounters start{};
+		std::uint64_t flushes = 0;
+		std::uint64_t frames = 0;
+		OutputCounters frameOutput{};
+		std::uint64_t largestFrame = 0;
+		/// Redraws by type of widget
+		std::map<std::string, WidgetOutput> widgets{};
+};
+
+} // end of namespace
+
+#endif
@@ -0,0 +1,207 @@
+#include "search.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+	/// Time between two batches of matches
+	constexpr auto deliveryPeriod = std::chrono::milliseconds(10);
+	/// Time waited for new lines when the source is not complete
+	constexpr auto growthPeriod = std::chrono::milliseconds(20);
+
+	/// Find a literal in a text. Returns nullptr if it is not found
+	const char * findLiteral(const char * text, std::size_t length, const std::string & needle)
+	{
+		auto size = needle.size();
+		if (size == 0 || size > length)
+			return nullptr;
+		auto cursor = text;
+		auto last = text + length - size;
+		while (cursor <= last)
+		{
+			auto found = static_cast<const char *>(std::memchr(cursor, needle[0], last - cursor + 1));
+			if (found == nullptr)
+				return nullptr;
+			if (std::memcmp(found + 1, needle.data() + 1, size - 1) == 0)
+				return found;
+			cursor = found + 1;
+		}
+		return nullptr;
+	}
+
+	/// Find a literal, ignoring the case. The needle is in lower case
+	const char * findLiteralNoCase(const char * text, std::size_t length, const std::string & needle)
+	{
+		auto size = needle.size();
+		if (size == 0 || size > length)
+			return nullptr;
+		auto same = [](char a, char b)
+		{
+			return std::tolower(static_cast<unsigned char>(a)) == b;
+		};
+		auto found = std::search(text, text + length, needle.begin(), needle.end(), same);
+		return found == text + length ? nullptr : found;
+	}
+}
+
+tui::TextSearch::TextSearch(Delivery delivery)
+	: delivery(std::move(delivery))
+{
+	thread = std::thread(&TextSearch::run, this);
+}
+
+tui::TextSearch::~TextSearch()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		++generation;
+	}
+	wake.notify_all();
+	thread.join();
+}
+
+std::uint64_t tui::TextSearch::start(std::shared_ptr<const SearchSource> source, const std::string & query,
+		SearchOptions options)
+{
+	auto job = std::make_unique<Job>();
+	job->source = std::move(source);
+	job->query = query;
+	job->options = options;
+	if (options.regex)
+	{
+		auto flags = std::regex::ECMAScript | std::regex::optimize;
+		if (options.ignoreCase)
+			flags |= std::regex::icase;
+		job->regex = std::make_unique<std::regex>(query, flags);
+	}
+	else if (options.ignoreCase)
+	{
+		for (auto & c : job->query)
+			c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+	}
+	std::uint64_t result{};
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		result = ++generation;
+		job->generation = result;
+		pending = std::move(job);
+	}
+	wake.notify_all();
+	return result;
+}
+
+void tui::TextSearch::cancel()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	++generation;
+	pending.reset();
+	wake.notify_all();
+	idle.wait(lock, [this]() { return !busy; });
+}
+
+void tui::TextSearch::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;)
+	{
+		wake.wait(lock, [this]() { return stopping || pending; });
+		if (stopping)
+			return;
+		auto job = std::move(pending);
+		busy = true;
+		lock.unlock();
+		execute(*job);
+		// The source is released before the thread is seen idle
+		job.reset();
+		lock.lock();
+		busy = false;
+		idle.notify_all();
+	}
+}
+
+void tui::TextSearch::execute(const Job & job)
+{
+	std::vector<SearchMatch> batch;
+	std::string buffer;
+	std::size_t found = 0;
+	std::size_t line = 0;
+	auto lastDelivery = std::chrono::steady_clock::now();
+	auto & source = *job.source;
+	for (;;)
+	{
+		// The completion is read first: the count read after it is final
+		auto complete = source.isComplete();
+		auto count = source.lineCount();
+		for (; line < count && found < job.options.maxMatches; ++line)
+		{
+			if (cancelled(job))
+				return;
+			const char * text;
+			std::size_t length;
+			source.line(line, buffer, text, length);
+			match(job, line, text, length, batch, found);
+			if ((line & 255) == 0 && !batch.empty())
+			{
+				auto now = std::chrono::steady_clock::now();
+				if (now - lastDelivery >= deliveryPeriod)
+				{
+					delivery(job.generation, std::move(batch), false);
+					batch.clear();
+					lastDelivery = now;
+				}
+			}
+		}
+		if (complete || found >= job.options.maxMatches)
+			break;
+		// Wait for the source to grow, or for the search to be cancelled
+		std::unique_lock<std::mutex> lock(mutex);
+		wake.wait_for(lock, growthPeriod, [this, &job]() { return stopping || cancelled(job); });
+		if (cancelled(job))
+			return;
+	}
+	if (!cancelled(job))
+		delivery(job.generation, std::move(batch), true);
+}
+
+void tui::TextSearch::match(const Job & job, std::size_t line, const char * text, std::size_t length,
+		std::vector<SearchMatch> & matches, std::size_t & found)
+{
+	auto end = text + length;
+	if (job.regex)
+	{
+		std::cmatch result;
+		auto cursor = text;
+		auto flags = std::regex_constants::match_default;
+		while (found < job.options.maxMatches && std::regex_search(cursor, end, result, *job.regex, flags))
+		{
+			auto position = result[0].first;
+			auto size = static_cast<std::size_t>(result.length(0));
+			// Empty matches are not displayed
+			if (size != 0)
+			{
+				matches.push_back({line, static_cast<std::size_t>(position - text), size});
+				++found;
+			}
+			cursor = position + std::max<std::size_t>(size, 1);
+			if (cursor > end)
+				break;
+			flags = std::regex_constants::match_prev_avail;
+		}
+		return;
+	}
+	auto cursor = text;
+	while (found < job.options.maxMatches)
+	{
+		auto position = job.options.ignoreCase
+			? findLiteralNoCase(cursor, end - cursor, job.query)
+			: findLiteral(cursor, end - cursor, job.query);
+		if (position == nullptr)
+			break;
+		matches.push_back({line, static_cast<std::size_t>(position - text), job.query.size()});
+		++found;
+		cursor = position + job.query.size();
+	}
+}
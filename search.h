@@ -0,0 +1,146 @@
+#ifndef TUI_SEARCH_H
+#define TUI_SEARCH_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace tui
+
+{
+
+/// Position of a match in the searched text
+struct SearchMatch
+{
+	std::size_t line;	//< Index of the line
+	std::size_t column;	//< Offset of the match in the line
+	std::size_t length;	//< Length of the match
+};
+
+/// Options of a search
+struct SearchOptions
+{
+	bool regex = false;	//< The query is an ECMAScript regular expression
+	bool ignoreCase = false;
+	std::size_t maxMatches = 100000;	//< The search stops after this number of matches
+};
+
+/***************************************************************************//*
+Lines searched by a TextSearch.
+
+The functions are called from the search thread. The source can grow while it
+is searched: the search waits for new lines until isComplete() returns true.
+
+******************************************************************************/
+class SearchSource
+{
+	public:
+		virtual ~SearchSource() = default;
+
+		/// Number of lines available
+		virtual std::size_t lineCount() const = 0;
+
+		/// True when no more lines will be added
+		virtual bool isComplete() const
+		{
+			return true;
+		}
+
+		/// Get the line n. text either points to memory owned by the source or
+		/// to the buffer, which the source can use to build the line
+		virtual void line(std::size_t n, std::string & buffer, const char *& text, std::size_t & length) const = 0;
+};
+
+/***************************************************************************//*
+Search of text on a background thread.
+
+A search is started with start(), which returns immediately. The thread finds
+the matches line after line and hands them to the delivery function in
+batches, at most every few milliseconds, so that they can be displayed while
+the search goes on. Literal queries are found with memchr and memcmp, which
+are vectorized by the C library.
+
+Starting a new search cancels the current one: each search has a generation
+number, checked by the thread for each line, and the batches carry the
+generation of their search so that stale batches can be ignored.
+
+******************************************************************************/
+class TextSearch
+{
+	public:
+		/// Function receiving the matches. It is called from the search thread,
+		/// with finished set to true for the last batch of a search
+		using Delivery = std::function<void(std::uint64_t generation, std::vector<SearchMatch> matches, bool finished)>;
+
+		explicit TextSearch(Delivery delivery);
+		/// Stop the search thread
+		~TextSearch();
+
+		TextSearch(const TextSearch &) = delete;
+		TextSearch & operator=(const TextSearch &) = delete;
+
+		/// Start a search and return its generation. The current search is
+		/// cancelled. Throws std::regex_error if the regular expression is invalid
+		std::uint64_t start(std::shared_ptr<const SearchSource> source, const std::string & query,
+				SearchOptions options = {});
+
+		/// Cancel the current search. When the function returns, the search
+		/// thread does not access the source anymore
+		void cancel();
+
+		/// Generation of the last search started or cancelled
+		std::uint64_t getGeneration() const
+		{
+			return generation.load(std::memory_order_acquire);
+		}
+
+	private:
+		struct Job
+		{
+			std::uint64_t generation;
+			std::shared_ptr<const SearchSource> source;
+			std::string query;
+			SearchOptions options;
+			std::unique_ptr<std::regex> regex;
+		};
+
+		/// Body of the search thread
+		void run();
+		/// Search all the lines of the source of a job
+		void execute(const Job & job);
+		/// Find the matches in a line
+		void match(const Job & job, std::size_t line, const char * text, std::size_t length,
+				std::vector<SearchMatch> & matches, std::size_t & found);
+		/// True when the job has been cancelled
+		bool cancelled(const Job & job) const
+		{
+			return generation.load(std::memory_order_relaxed) != job.generation;
+		}
+
+		Delivery delivery;
+		mutable std::mutex mutex{};
+		/// Signaled when a job is posted, cancelled or when the thread must stop
+		std::condition_variable wake{};
+		/// Signaled when the thread has finished a job
+		std::condition_variable idle{};
+		/// Job waiting to be executed
+		std::unique_ptr<Job> pending{};
+		std::atomic<std::uint64_t> generation{0};
+		/// True while the thread executes a job
+		bool busy = false;
+		bool stopping = false;
+		std::thread thread;
+};
+
+} // end of namespace
+
+#endif
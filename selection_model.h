@@ -0,0 +1,259 @@
+#ifndef TUI_SELECTION_MODEL_H
+#define TUI_SELECTION_MODEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+
+namespace tui
+
+{
+
+/***************************************************************************//*
+Selection state of a list of items, stored as a bitset.
+
+The whole list operations (select all, clear, invert, ranges) work on 64 items
+at a time, counting uses popcount and the iteration on the selected items only
+visits the set bits.
+
+The model remembers which words have changed since the last synchronization
+with a view (syncChanges), so that the view only receives the items whose state
+is different. Listeners are notified of the range of items modified by each
+operation.
+
+******************************************************************************/
+class SelectionModel
+{
+	public:
+		/// Function called with the range [first, last) of items modified
+		using Listener = std::function<void(std::size_t first, std::size_t last)>;
+
+		explicit SelectionModel(std::size_t size = 0)
+		{
+			resize(size);
+		}
+
+		/// Change the number of items. The new items are not selected
+		void resize(std::size_t size)
+		{
+			nbrItems = size;
+			auto nbrWords = (size + 63) / 64;
+			words.resize(nbrWords, 0);
+			synced.resize(nbrWords, 0);
+			changed.resize((nbrWords + 63) / 64, 0);
+			// The bits beyond the last item must stay cleared
+			if (size % 64 != 0)
+			{
+				words.back() &= lastMask();
+				synced.back() &= lastMask();
+			}
+			// And so must the changes of the words removed by a shrink
+			if (nbrWords % 64 != 0)
+				changed.back() &= (std::uint64_t(1) << (nbrWords % 64)) - 1;
+		}
+
+		/// Number of items
+		std::size_t size() const
+		{
+			return nbrItems;
+		}
+
+		/// Return true if the item is selected
+		bool isSelected(std::size_t index) const
+		{
+			return (words[index / 64] >> (index % 64)) & 1;
+		}
+
+		/// Select or deselect an item
+		void set(std::size_t index, bool value = true)
+		{
+			auto & word = words[index / 64];
+			auto bit = std::uint64_t(1) << (index % 64);
+			if (((word & bit) != 0) == value)
+				return;
+			word ^= bit;
+			markChanged(index / 64);
+			notify(index, index + 1);
+		}
+
+		void select(std::size_t index)
+		{
+			set(index, true);
+		}
+
+		void deselect(std::size_t index)
+		{
+			set(index, false);
+		}
+
+		void toggle(std::size_t index)
+		{
+			set(index, !isSelected(index));
+		}
+
+		/// Select or deselect the items of the range [first, last)
+		void setRange(std::size_t first, std::size_t last, bool value = true)
+		{
+			applyRange(first, last, [value](std::uint64_t word, std::uint64_t mask)
+				{
+					return value ? word | mask : word & ~mask;
+				});
+		}
+
+		/// Invert the selection of the items of the range [first, last)
+		void invertRange(std::size_t first, std::size_t last)
+		{
+			applyRange(first, last, [](std::uint64_t word, std::uint64_t mask)
+				{
+					return word ^ mask;
+				});
+		}
+
+		void selectAll()
+		{
+			setRange(0, nbrItems, true);
+		}
+
+		void clear()
+		{
+			setRange(0, nbrItems, false);
+		}
+
+		void invert()
+		{
+			invertRange(0, nbrItems);
+		}
+
+		/// Number of selected items
+		std::size_t count() const
+		{
+			std::size_t total{};
+			for (auto word : words)
+				total += __builtin_popcountll(word);
+			return total;
+		}
+
+		/// Call fn(index) for each selected item, in increasing order
+		template <typename F>
+		void forEachSelected(F fn) const
+		{
+			for (std::size_t w = 0; w < words.size(); ++w)
+			{
+				for (auto word = words[w]; word != 0; word &= word - 1)
+					fn(w * 64 + __builtin_ctzll(word));
+			}
+		}
+
+		/// Call fn(index, selected) for each item whose state has changed since
+		/// the previous call, then consider the view synchronized
+		template <typename F>
+		void syncChanges(F fn)
+		{
+			for (std::size_t c = 0; c < changed.size(); ++c)
+			{
+				for (auto bits = changed[c]; bits != 0; bits &= bits - 1)
+				{
+					auto w = c * 64 + __builtin_ctzll(bits);
+					for (auto diff = words[w] ^ synced[w]; diff != 0; diff &= diff - 1)
+					{
+						auto index = w * 64 + __builtin_ctzll(diff);
+						fn(index, isSelected(index));
+					}
+					synced[w] = words[w];
+				}
+				changed[c] = 0;
+			}
+		}
+
+		/// Record a state which is already known by the view, for instance when
+		/// the user has changed it in the view
+		void setSynced(std::size_t index, bool value)
+		{
+			auto bit = std::uint64_t(1) << (index % 64);
+			auto & word = words[index / 64];
+			auto old = (word & bit) != 0;
+			if (value)
+			{
+				word |= bit;
+				synced[index / 64] |= bit;
+			}
+			else
+			{
+				word &= ~bit;
+				synced[index / 64] &= ~bit;
+			}
+			if (old != value)
+				notify(index, index + 1);
+		}
+
+		/// Add a function called after each modification
+		void addListener(Listener listener)
+		{
+			listeners.push_back(std::move(listener));
+		}
+
+	private:
+		/// Mask of the valid bits of the last word
+		std::uint64_t lastMask() const
+		{
+			return nbrItems % 64 == 0 ? ~std::uint64_t(0) : (std::uint64_t(1) << (nbrItems % 64)) - 1;
+		}
+
+		void markChanged(std::size_t word)
+		{
+			changed[word / 64] |= std::uint64_t(1) << (word % 64);
+		}
+
+		void notify(std::size_t first, std::size_t last)
+		{
+			for (auto & listener : listeners)
+				listener(first, last);
+		}
+
+		/// Apply op(word, mask) to the words covering [first, last). The mask
+		/// gives the bits of the word which belong to the range. The listeners
+		/// are only notified if an item has changed
+		template <typename Op>
+		void applyRange(std::size_t first, std::size_t last, Op op)
+		{
+			if (last > nbrItems)
+				last = nbrItems;
+			if (first >= last)
+				return;
+			auto firstWord = first / 64;
+			auto lastWord = (last - 1) / 64;
+			bool modified = false;
+			for (auto w = firstWord; w <= lastWord; ++w)
+			{
+				auto mask = ~std::uint64_t(0);
+				if (w == firstWord)
+					mask &= ~std::uint64_t(0) << (first % 64);
+				if (w == lastWord && last % 64 != 0)
+					mask &= (std::uint64_t(1) << (last % 64)) - 1;
+				auto value = op(words[w], mask);
+				if (value != words[w])
+				{
+					words[w] = value;
+					markChanged(w);
+					modified = true;
+				}
+			}
+			if (modified)
+				notify(first, last);
+		}
+
+		std::size_t nbrItems{};
+		/// One bit per item
+		std::vector<std::uint64_t> words{};
+		/// State of the words when the view was last synchronized
+		std::vector<std::uint64_t> synced{};
+		/// One bit per word which has changed since the last synchronization
+		std::vector<std::uint64_t> changed{};
+		std::vector<Listener> listeners{};
+};
+
+} // end of namespace
+
+#endif
@@ -0,0 +1,112 @@
+#include "update_queue.h"
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cstdint>
+#include <system_error>
+#include <cerrno>
+
+// The queue is the intrusive MPSC queue of D. Vyukov. Producers exchange the
+// head pointer then link the previous head to their node. The consumer walks
+// from the tail. The stub node keeps the list non empty.
+
+tui::UpdateQueue::UpdateQueue()
+	: head(&stub), tail(&stub)
+{
+	eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (eventFd < 0)
+		throw std::system_error(errno, std::generic_category(), "eventfd");
+}
+
+tui::UpdateQueue::~UpdateQueue()
+{
+	while (auto node = pop())
+		delete node;
+	close(eventFd);
+}
+
+void tui::UpdateQueue::post(Update update)
+{
+	auto node = new Node;
+	node->update = std::move(update);
+	push(node);
+	wakeup();
+}
+
+std::size_t tui::UpdateQueue::drain(std::size_t maxUpdates)
+{
+	// Consume the wake up first: a post done from now on signals again
+	std::uint64_t count{};
+	if (read(eventFd, &count, sizeof(count)) < 0)
+	{
+		// Nothing to read, the wake up was consumed by a previous drain
+	}
+	wakeupPending.store(false);
+
+	std::size_t done{};
+	while (done < maxUpdates)
+	{
+		auto node = pop();
+		if (node == nullptr)
+			break;
+		node->update();
+		delete node;
+		++done;
+	}
+	// Remaining updates, or a producer still linking its node, must not be
+	// left without a wake up
+	if (done == maxUpdates || head.load() != tail)
+		wakeup();
+	return done;
+}
+
+void tui::UpdateQueue::push(Node * node)
+{
+	node->next.store(nullptr, std::memory_order_relaxed);
+	auto prev = head.exchange(node, std::memory_order_acq_rel);
+	prev->next.store(node, std::memory_order_release);
+}
+
+tui::UpdateQueue::Node * tui::UpdateQueue::pop()
+{
+	auto node = tail;
+	auto next = node->next.load(std::memory_order_acquire);
+	if (node == &stub)
+	{
+		if (next == nullptr)
+			return nullptr;
+		// Skip the stub
+		tail = next;
+		node = next;
+		next = next->next.load(std::memory_order_acquire);
+	}
+	if (next != nullptr)
+	{
+		tail = next;
+		return node;
+	}
+	// node is the last one linked. If a producer has already exchanged the
+	// head, it is still linking its node: try again later
+	if (node != head.load(std::memory_order_acquire))
+		return nullptr;
+	// Put the stub back behind the last node so that it can be unlinked
+	push(&stub);
+	next = node->next.load(std::memory_order_acquire);
+	if (next != nullptr)
+	{
+		tail = next;
+		return node;
+	}
+	return nullptr;
+}
+
+void tui::UpdateQueue::wakeup()
+{
+	if (!wakeupPending.exchange(true))
+	{
+		std::uint64_t one = 1;
+		if (write(eventFd, &one, sizeof(one)) < 0)
+		{
+			// The counter can only overflow if nobody drains the queue
+		}
+	}
+}
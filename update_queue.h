@@ -0,0 +1,79 @@
+#ifndef TUI_UPDATE_QUEUE_H
+#define TUI_UPDATE_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+
+
+namespace tui
+
+{
+
+/***************************************************************************//*
+Queue of updates posted to the curses thread.
+
+Any thread can post an update (multiple producers). Only the curses thread
+drains the queue (single consumer) and runs the updates, so they can call the
+widget functions. The queue is lock free: posting is a single atomic exchange.
+
+The consumer is woken up through an eventfd which becomes readable when the
+queue goes from idle to non empty. It is written once per batch of posts, not
+once per post.
+
+******************************************************************************/
+class UpdateQueue
+{
+	public:
+		using Update = std::function<void()>;
+
+		UpdateQueue();
+		/// Destroy the queue. The updates still in the queue are discarded
+		~UpdateQueue();
+
+		UpdateQueue(const UpdateQueue &) = delete;
+		UpdateQueue & operator=(const UpdateQueue &) = delete;
+
+		/// Post an update. This can be called from any thread
+		void post(Update update);
+
+		/// Run at most maxUpdates queued updates. Must only be called from the
+		/// curses thread. Returns the number of updates run. If updates remain
+		/// in the queue, the eventfd is signaled again.
+		std::size_t drain(std::size_t maxUpdates = 4096);
+
+		/// File descriptor which is readable when updates are waiting
+		int getFd() const
+		{
+			return eventFd;
+		}
+
+	private:
+		struct Node
+		{
+			std::atomic<Node *> next{nullptr};
+			Update update{};
+		};
+
+		/// Link a node at the head of the queue
+		void push(Node * node);
+		/// Unlink the oldest node. Returns nullptr if the queue is empty or if
+		/// the last producer has not finished linking its node
+		Node * pop();
+		/// Signal the eventfd unless a wake up is already pending
+		void wakeup();
+
+		/// Last node pushed by the producers
+		std::atomic<Node *> head;
+		/// Oldest node, only accessed by the consumer
+		Node * tail;
+		/// Node always present in the queue so that it is never empty
+		Node stub{};
+		/// True when the eventfd has been signaled and not yet consumed
+		std::atomic<bool> wakeupPending{false};
+		int eventFd = -1;
+};
+
+} // end of namespace
+
+#endif
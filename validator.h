@@ -0,0 +1,733 @@
+#ifndef TUI_VALIDATOR_H
+#define TUI_VALIDATOR_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+
+namespace tui
+
+{
+
+/***************************************************************************//*
+Deterministic automaton validating a text one character at a time.
+
+The bytes are first mapped to a few classes of characters which behave the
+same way, then the next state is read in a table indexed by the state and
+the class: checking a character is two array reads. State 0 is the dead
+state, from which no text can be accepted, and state 1 is the start state.
+A text is a valid prefix while its state is not dead, and it is valid when
+its state is accepting.
+
+The automatons are built by the constexpr functions of the validators
+namespace, so that the tables are computed at compile time:
+
+	static constexpr auto port = tui::validators::numericRange<5>(1, 65535);
+	entry.setValidator(port);
+
+******************************************************************************/
+template <std::size_t States, std::size_t Classes>
+struct Dfa
+{
+	using State = std::uint16_t;
+	static constexpr State dead = 0;
+	static constexpr State start = 1;
+	static_assert(States >= 2 && States <= 65535, "Invalid number of states");
+
+	/// Class of each byte
+	std::array<std::uint8_t, 256> classOf{};
+	/// Next state, indexed by state * Classes + class
+	std::array<State, States * Classes> table{};
+	std::array<bool, States> accepting{};
+
+	constexpr State next(State state, char c) const
+	{
+		return table[state * Classes + classOf[static_cast<unsigned char>(c)]];
+	}
+
+	/// Run the automaton on a text from a state
+	constexpr State run(const char * text, std::size_t length, State state = start) const
+	{
+		for (std::size_t i = 0; i < length && state != dead; ++i)
+			state = next(state, text[i]);
+		return state;
+	}
+
+	/// True if the text is valid
+	constexpr bool accepts(const char * text, std::size_t length) const
+	{
+		return accepting[run(text, length)];
+	}
+
+	/// True if characters can be added to the text to make it valid
+	constexpr bool isPrefix(const char * text, std::size_t length) const
+	{
+		return run(text, length) != dead;
+	}
+};
+
+/***************************************************************************//*
+Reference to the tables of a Dfa of any size, used by the widgets.
+
+The Dfa must outlive the validator: it is normally a static constexpr object.
+
+******************************************************************************/
+class Validator
+{
+public:
+	using State = std::uint16_t;
+	static constexpr State dead = 0;
+	static constexpr State start = 1;
+
+	constexpr Validator() = default;
+
+	template <std::size_t States, std::size_t Classes>
+	constexpr Validator(const Dfa<States, Classes> & dfa)
+		: classOf(dfa.classOf.data()), table(dfa.table.data()), accepting(dfa.accepting.data()),
+		classes(Classes)
+	{
+	}
+
+	/// True if the validator refers to an automaton
+	constexpr explicit operator bool() const
+	{
+		return table != nullptr;
+	}
+
+	constexpr State next(State state, char c) const
+	{
+		return table[state * classes + classOf[static_cast<unsigned char>(c)]];
+	}
+
+	constexpr State run(const char * text, std::size_t length, State state = start) const
+	{
+		for (std::size_t i = 0; i < length && state != dead; ++i)
+			state = next(state, text[i]);
+		return state;
+	}
+
+	constexpr bool isAccepting(State state) const
+	{
+		return accepting[state];
+	}
+
+	constexpr bool accepts(const char * text, std::size_t length) const
+	{
+		return accepting[run(text, length)];
+	}
+
+	constexpr bool isPrefix(const char * text, std::size_t length) const
+	{
+		return run(text, length) != dead;
+	}
+
+private:
+	const std::uint8_t * classOf = nullptr;
+	const State * table = nullptr;
+	const bool * accepting = nullptr;
+	std::size_t classes = 0;
+};
+
+/// Builders of the automatons. They are meant to be evaluated at compile time,
+/// where an automaton exceeding its size is a compilation error
+namespace validators
+
+{
+
+namespace detail
+
+{
+	/// Comparison of a number with a bound, digit by digit
+	enum : int {less = 0, equal = 1, greater = 2};
+
+	/// Digits of a number, most significant first. Returns the number of digits
+	template <std::size_t Digits>
+	constexpr std::size_t digitsOf(std::uint64_t value, std::array<int, Digits> & digits)
+	{
+		std::size_t count = 0;
+		auto rest = value;
+		do
+		{
+			++count;
+			rest /= 10;
+		} while (rest != 0);
+		if (count > Digits)
+			throw std::length_error("numericRange: too many digits");
+		for (auto i = count; i > 0; --i)
+		{
+			digits[i - 1] = static_cast<int>(value % 10);
+			value /= 10;
+		}
+		return count;
+	}
+
+	constexpr int compare(int a, int b)
+	{
+		return a < b ? less : a > b ? greater : equal;
+	}
+
+	/// Add the states of the numbers in [low, high], written without leading
+	/// zeros, from the state entry. The states used are base to base + 9 * Digits.
+	/// A state records the number of digits typed and how they compare to the
+	/// first digits of the two bounds.
+	template <std::size_t Digits, std::size_t States, std::size_t Classes>
+	constexpr void addRange(Dfa<States, Classes> & dfa, std::uint16_t entry, std::uint64_t low,
+			std::uint64_t high, std::uint16_t base)
+	{
+		std::array<int, Digits> lowDigits{};
+		std::array<int, Digits> highDigits{};
+		auto nl = digitsOf(low, lowDigits);
+		auto nh = digitsOf(high, highDigits);
+		// State of k digits (k >= 1) and of the comparisons with the bounds
+		auto id = [base](std::size_t k, int cl, int ch)
+		{
+			return static_cast<std::uint16_t>(base + 1 + (k - 1) * 9 + cl * 3 + ch);
+		};
+		// Some number of length in [max(k, nl), nh] with these first digits is
+		// in the range
+		auto feasible = [nl, nh](std::size_t k, int cl, int ch)
+		{
+			for (auto length = k > nl ? k : nl; length <= nh; ++length)
+				if ((length != nl || cl != less) && (length != nh || ch != greater))
+					return true;
+			return false;
+		};
+		// Digit d typed after k digits
+		auto target = [&](std::size_t k, int cl, int ch, int d) -> std::uint16_t
+		{
+			if (k + 1 > nh)
+				return 0;
+			auto cl2 = k + 1 > nl ? greater : cl == equal ? compare(d, lowDigits[k]) : cl;
+			auto ch2 = ch == equal ? compare(d, highDigits[k]) : ch;
+			return feasible(k + 1, cl2, ch2) ? id(k + 1, cl2, ch2) : 0;
+		};
+		// The digit classes are 1 to 10
+		// A single zero is accepted if it is in the range, and cannot be followed
+		if (low == 0)
+		{
+			dfa.table[entry * Classes + 1] = base;
+			dfa.accepting[base] = true;
+		}
+		for (int d = 1; d <= 9; ++d)
+			dfa.table[entry * Classes + 1 + d] = target(0, equal, equal, d);
+		for (std::size_t k = 1; k <= nh; ++k)
+			for (int cl = 0; cl < 3; ++cl)
+				for (int ch = 0; ch < 3; ++ch)
+				{
+					auto state = id(k, cl, ch);
+					dfa.accepting[state] = k >= nl && (k != nl || cl != less) && (k != nh || ch != greater);
+					for (int d = 0; d <= 9; ++d)
+						dfa.table[state * Classes + 1 + d] = target(k, cl, ch, d);
+				}
+	}
+}
+
+/// Integers in [low, high], with a leading minus sign for the negative ones
+/// and without leading zeros. Digits is the maximum number of digits of the
+/// bounds
+template <std::size_t Digits = 19>
+constexpr Dfa<3 + 2 * (1 + 9 * Digits), 12> numericRange(std::int64_t low, std::int64_t high)
+{
+	if (low > high)
+		throw std::invalid_argument("numericRange: empty range");
+	Dfa<3 + 2 * (1 + 9 * Digits), 12> dfa{};
+	// Class 0: other characters, 1 to 10: digits, 11: minus sign
+	for (int c = '0'; c <= '9'; ++c)
+		dfa.classOf[c] = static_cast<std::uint8_t>(1 + c - '0');
+	dfa.classOf['-'] = 11;
+	constexpr std::uint16_t minus = 2;
+	constexpr std::uint16_t positiveBase = 3;
+	constexpr std::uint16_t negativeBase = 3 + 1 + 9 * Digits;
+	if (high >= 0)
+		detail::addRange<Digits>(dfa, 1, low > 0 ? static_cast<std::uint64_t>(low) : 0,
+				static_cast<std::uint64_t>(high), positiveBase);
+	if (low < 0)
+	{
+		dfa.table[1 * 12 + 11] = minus;
+		// Magnitudes of the negative numbers, computed without overflow
+		auto largest = static_cast<std::uint64_t>(-(low + 1)) + 1;
+		auto smallest = high < 0 ? static_cast<std::uint64_t>(-(high + 1)) + 1 : 1;
+		detail::addRange<Digits>(dfa, minus, smallest, largest, negativeBase);
+	}
+	return dfa;
+}
+
+/// Hexadecimal numbers of minDigits to maxDigits digits, in any case
+template <std::size_t MaxDigits = 16>
+constexpr Dfa<MaxDigits + 2, 2> hexNumber(std::size_t minDigits = 1, std::size_t maxDigits = MaxDigits)
+{
+	if (maxDigits > MaxDigits || minDigits > maxDigits)
+		throw std::invalid_argument("hexNumber: invalid number of digits");
+	Dfa<MaxDigits + 2, 2> dfa{};
+	for (int c = 0; c < 256; ++c)
+		dfa.classOf[c] = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+	// State 1 + k after k digits
+	for (std::size_t k = 0; k <= maxDigits; ++k)
+	{
+		auto state = 1 + k;
+		dfa.accepting[state] = k >= minDigits;
+		dfa.table[state * 2 + 1] = k < maxDigits ? static_cast<std::uint16_t>(state + 1) : 0;
+	}
+	return dfa;
+}
+
+/// Count texts accepted by element, separated by a character which the
+/// element does not accept
+template <std::size_t Count, std::size_t States, std::size_t Classes>
+constexpr Dfa<1 + Count * (States - 1), Classes + 1> separated(const Dfa<States, Classes> & element, char separator)
+{
+	static_assert(Count >= 1, "At least one element is needed");
+	Dfa<1 + Count * (States - 1), Classes + 1> dfa{};
+	constexpr std::size_t OutClasses = Classes + 1;
+	dfa.classOf = element.classOf;
+	dfa.classOf[static_cast<unsigned char>(separator)] = static_cast<std::uint8_t>(Classes);
+	// State s of the copy i becomes 1 + i * (States - 1) + s - 1
+	auto map = [](std::size_t i, std::size_t s)
+	{
+		return static_cast<std::uint16_t>(s == 0 ? 0 : 1 + i * (States - 1) + s - 1);
+	};
+	for (std::size_t i = 0; i < Count; ++i)
+		for (std::size_t s = 1; s < States; ++s)
+		{
+			auto state = map(i, s);
+			for (std::size_t c = 0; c < Classes; ++c)
+				dfa.table[state * OutClasses + c] = map(i, element.table[s * Classes + c]);
+			if (element.accepting[s])
+			{
+				if (i + 1 < Count)
+					dfa.table[state * OutClasses + Classes] = map(i + 1, 1);
+				else
+					dfa.accepting[state] = true;
+			}
+		}
+	return dfa;
+}
+
+/// IPv4 address in dotted decimal notation
+constexpr auto ipv4()
+{
+	return separated<4>(numericRange<3>(0, 255), '.');
+}
+
+/// IPv6 address: up to 8 groups of 1 to 4 hexadecimal digits separated by
+/// colons, with at most one :: standing for the omitted groups. The notation
+/// ending with an IPv4 address is not accepted.
+constexpr Dfa<2 + 9 * 5 * 2 * 3, 3> ipv6()
+{
+	Dfa<2 + 9 * 5 * 2 * 3, 3> dfa{};
+	// Class 0: other characters, 1: hexadecimal digits, 2: colon
+	for (int c = 0; c < 256; ++c)
+		dfa.classOf[c] = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+	dfa.classOf[':'] = 2;
+	// A state records the number of groups started, the digits of the current
+	// group, whether :: has been seen and the number of colons just typed
+	auto id = [](int groups, int digits, int compressed, int colons)
+	{
+		return static_cast<std::uint16_t>(2 + ((groups * 5 + digits) * 2 + compressed) * 3 + colons);
+	};
+	// The start state is the state of no group
+	auto stateOf = [&](int groups, int digits, int compressed, int colons) -> std::uint16_t
+	{
+		return groups == 0 && digits == 0 && compressed == 0 && colons == 0 ? 1 : id(groups, digits, compressed, colons);
+	};
+	for (int groups = 0; groups <= 8; ++groups)
+		for (int digits = 0; digits <= 4; ++digits)
+			for (int compressed = 0; compressed < 2; ++compressed)
+				for (int colons = 0; colons < 3; ++colons)
+				{
+					auto state = stateOf(groups, digits, compressed, colons);
+					auto maxGroups = compressed ? 7 : 8;
+					dfa.accepting[state] = groups <= maxGroups && ((colons == 0 && digits > 0 && (compressed || groups == 8))
+							|| (colons == 2 && compressed));
+					std::uint16_t hex = 0;
+					std::uint16_t colon = 0;
+					if (colons == 0 && digits > 0)
+					{
+						// In a group
+						if (digits < 4)
+							hex = stateOf(groups, digits + 1, compressed, 0);
+						colon = stateOf(groups, 0, compressed, 1);
+					}
+					else if (colons == 0)
+					{
+						// Start
+						hex = groups + 1 <= maxGroups ? stateOf(groups + 1, 1, compressed, 0) : 0;
+						colon = stateOf(groups, 0, compressed, 1);
+					}
+					else if (colons == 1)
+					{
+						// A single colon cannot start the address
+						if (groups > 0 && groups + 1 <= maxGroups)
+							hex = stateOf(groups + 1, 1, compressed, 0);
+						if (!compressed && groups <= 7)
+							colon = stateOf(groups, 0, 1, 2);
+					}
+					else if (groups + 1 <= maxGroups)
+						hex = stateOf(groups + 1, 1, compressed, 0);
+					dfa.table[state * 3 + 1] = hex;
+					dfa.table[state * 3 + 2] = colon;
+				}
+	return dfa;
+}
+
+namespace detail
+
+{
+	/// Set of 256 bytes
+	struct ByteSet
+	{
+		std::array<std::uint64_t, 4> bits{};
+
+		constexpr void add(unsigned c)
+		{
+			bits[c >> 6] |= std::uint64_t(1) << (c & 63);
+		}
+		constexpr void addRange(unsigned first, unsigned last)
+		{
+			for (auto c = first; c <= last; ++c)
+				add(c);
+		}
+		constexpr bool contains(unsigned c) const
+		{
+			return (bits[c >> 6] >> (c & 63)) & 1;
+		}
+		constexpr void invert()
+		{
+			for (auto & word : bits)
+				word = ~word;
+		}
+	};
+
+	/// Glushkov construction of the automaton of a pattern. Each character of
+	/// the pattern is a position; the automaton of positions is then made
+	/// deterministic by the subset construction. Positions are sets in a 64
+	/// bit word, the last bit being the start.
+	class PatternCompiler
+	{
+	public:
+		static constexpr std::size_t maxPositions = 63;
+		static constexpr std::uint64_t startBit = std::uint64_t(1) << 63;
+
+		/// Nullable flag, first and last positions of a sub expression
+		struct Info
+		{
+			bool nullable = true;
+			std::uint64_t first = 0;
+			std::uint64_t last = 0;
+		};
+
+		constexpr explicit PatternCompiler(const char * pattern)
+			: text(pattern)
+		{
+			auto info = parseAlternative();
+			if (text[cursor] != '\0')
+				throw std::invalid_argument("pattern: unexpected character");
+			follow[63] = info.first;
+			nullable = info.nullable;
+			last = info.last;
+		}
+
+		std::array<ByteSet, maxPositions> positions{};
+		std::array<std::uint64_t, 64> follow{};
+		std::size_t count = 0;
+		bool nullable = false;
+		std::uint64_t last = 0;
+
+	private:
+		static constexpr Info concat(const Info & a, const Info & b, std::array<std::uint64_t, 64> & follow)
+		{
+			for (std::size_t p = 0; p < 64; ++p)
+				if ((a.last >> p) & 1)
+					follow[p] |= b.first;
+			Info result{};
+			result.nullable = a.nullable && b.nullable;
+			result.first = a.first | (a.nullable ? b.first : 0);
+			result.last = b.last | (b.nullable ? a.last : 0);
+			return result;
+		}
+
+		constexpr void loop(const Info & a)
+		{
+			for (std::size_t p = 0; p < 64; ++p)
+				if ((a.last >> p) & 1)
+					follow[p] |= a.first;
+		}
+
+		constexpr Info parseAlternative()
+		{
+			auto result = parseSequence();
+			while (text[cursor] == '|')
+			{
+				++cursor;
+				auto other = parseSequence();
+				result.nullable = result.nullable || other.nullable;
+				result.first |= other.first;
+				result.last |= other.last;
+			}
+			return result;
+		}
+
+		constexpr Info parseSequence()
+		{
+			Info result{};
+			while (text[cursor] != '\0' && text[cursor] != '|' && text[cursor] != ')')
+				result = concat(result, parseRepeat(), follow);
+			return result;
+		}
+
+		constexpr std::size_t parseNumber()
+		{
+			std::size_t value = 0;
+			if (text[cursor] < '0' || text[cursor] > '9')
+				throw std::invalid_argument("pattern: number expected");
+			while (text[cursor] >= '0' && text[cursor] <= '9')
+				value = value * 10 + static_cast<std::size_t>(text[cursor++] - '0');
+			return value;
+		}
+
+		constexpr Info parseRepeat()
+		{
+			auto atomStart = cursor;
+			auto result = parseAtom();
+			for (;;)
+			{
+				auto c = text[cursor];
+				if (c == '*' || c == '+')
+				{
+					++cursor;
+					loop(result);
+					if (c == '*')
+						result.nullable = true;
+				}
+				else if (c == '?')
+				{
+					++cursor;
+					result.nullable = true;
+				}
+				else if (c == '{')
+				{
+					// The atom is parsed again for each copy, giving new positions
+					++cursor;
+					auto low = parseNumber();
+					auto high = low;
+					bool unbounded = false;
+					if (text[cursor] == ',')
+					{
+						++cursor;
+						if (text[cursor] == '}')
+							unbounded = true;
+						else
+							high = parseNumber();
+					}
+					if (text[cursor] != '}' || high < low || high == 0)
+						throw std::invalid_argument("pattern: invalid repetition");
+					auto end = ++cursor;
+					auto copies = unbounded ? (low > 0 ? low : 1) : high;
+					auto combined = result;
+					combined.nullable = combined.nullable || low == 0;
+					for (std::size_t n = 2; n <= copies; ++n)
+					{
+						cursor = atomStart;
+						auto copy = parseAtom();
+						if (n > low)
+							copy.nullable = true;
+						if (unbounded && n == copies)
+							loop(copy);
+						combined = concat(combined, copy, follow);
+					}
+					if (unbounded && copies == 1)
+						loop(combined);
+					cursor = end;
+					result = combined;
+				}
+				else
+					return result;
+			}
+		}
+
+		constexpr Info position(const ByteSet & set)
+		{
+			if (count == maxPositions)
+				throw std::length_error("pattern: too many positions");
+			positions[count] = set;
+			Info result{};
+			result.nullable = false;
+			result.first = std::uint64_t(1) << count;
+			result.last = result.first;
+			++count;
+			return result;
+		}
+
+		/// Escaped character: class or literal
+		constexpr ByteSet parseEscape()
+		{
+			ByteSet set{};
+			auto c = text[cursor++];
+			switch (c)
+			{
+				case 'd':
+					set.addRange('0', '9');
+					break;
+				case 'x':
+					set.addRange('0', '9');
+					set.addRange('a', 'f');
+					set.addRange('A', 'F');
+					break;
+				case 'w':
+					set.addRange('0', '9');
+					set.addRange('a', 'z');
+					set.addRange('A', 'Z');
+					set.add('_');
+					break;
+				case 's':
+					set.add(' ');
+					set.add('\t');
+					break;
+				case '\0':
+					throw std::invalid_argument("pattern: escape at the end");
+				default:
+					set.add(static_cast<unsigned char>(c));
+			}
+			return set;
+		}
+
+		constexpr ByteSet parseClass()
+		{
+			ByteSet set{};
+			bool negated = text[cursor] == '^';
+			if (negated)
+				++cursor;
+			while (text[cursor] != ']')
+			{
+				if (text[cursor] == '\0')
+					throw std::invalid_argument("pattern: unterminated class");
+				if (text[cursor] == '\\')
+				{
+					++cursor;
+					auto escaped = parseEscape();
+					for (auto i = 0; i < 4; ++i)
+						set.bits[i] |= escaped.bits[i];
+					continue;
+				}
+				auto first = static_cast<unsigned char>(text[cursor++]);
+				if (text[cursor] == '-' && text[cursor + 1] != ']' && text[cursor + 1] != '\0')
+				{
+					auto last = static_cast<unsigned char>(text[cursor + 1]);
+					cursor += 2;
+					set.addRange(first, last);
+				}
+				else
+					set.add(first);
+			}
+			++cursor;
+			if (negated)
+				set.invert();
+			return set;
+		}
+
+		constexpr Info parseAtom()
+		{
+			auto c = text[cursor++];
+			ByteSet set{};
+			switch (c)
+			{
+				case '(':
+				{
+					auto result = parseAlternative();
+					if (text[cursor] != ')')
+						throw std::invalid_argument("pattern: missing )");
+					++cursor;
+					return result;
+				}
+				case '[':
+					return position(parseClass());
+				case '.':
+					set.addRange(' ', 126);
+					return position(set);
+				case '\\':
+					return position(parseEscape());
+				case '*':
+				case '+':
+				case '?':
+				case '{':
+				case ')':
+				case '\0':
+					throw std::invalid_argument("pattern: unexpected character");
+				default:
+					set.add(static_cast<unsigned char>(c));
+					return position(set);
+			}
+		}
+
+		const char * text;
+		std::size_t cursor = 0;
+	};
+}
+
+/// Texts matching a pattern in a small regular expression language: literal
+/// characters, . (printable character), classes [a-z] and [^...], escapes \d
+/// \x (hexadecimal digit) \w \s, groups ( ), alternatives |, and the repetitions
+/// ? * + {n} {m,n} {m,}. The pattern must match the whole text.
+template <std::size_t States = 64, std::size_t Classes = 16>
+constexpr Dfa<States, Classes> pattern(const char * text)
+{
+	detail::PatternCompiler compiler(text);
+	Dfa<States, Classes> dfa{};
+	// The bytes matched by the same positions are in the same class. Class 0
+	// is the class of the bytes matched by no position
+	std::array<std::uint64_t, Classes> classPositions{};
+	std::size_t classCount = 1;
+	for (unsigned c = 0; c < 256; ++c)
+	{
+		std::uint64_t signature = 0;
+		for (std::size_t p = 0; p < compiler.count; ++p)
+			if (compiler.positions[p].contains(c))
+				signature |= std::uint64_t(1) << p;
+		std::size_t index = 0;
+		while (index < classCount && classPositions[index] != signature)
+			++index;
+		if (index == classCount)
+		{
+			if (classCount == Classes)
+				throw std::length_error("pattern: too many classes");
+			classPositions[classCount++] = signature;
+		}
+		dfa.classOf[c] = static_cast<std::uint8_t>(index);
+	}
+	// Subset construction. A state is the set of the last positions matched
+	std::array<std::uint64_t, States> sets{};
+	sets[1] = detail::PatternCompiler::startBit;
+	std::size_t stateCount = 2;
+	auto accepting = compiler.last | (compiler.nullable ? detail::PatternCompiler::startBit : 0);
+	for (std::size_t state = 1; state < stateCount; ++state)
+	{
+		dfa.accepting[state] = (sets[state] & accepting) != 0;
+		std::uint64_t reachable = 0;
+		for (std::size_t p = 0; p < 64; ++p)
+			if ((sets[state] >> p) & 1)
+				reachable |= compiler.follow[p];
+		for (std::size_t c = 0; c < classCount; ++c)
+		{
+			auto target = reachable & classPositions[c];
+			std::size_t index = 0;
+			while (index < stateCount && sets[index] != target)
+				++index;
+			if (index == stateCount)
+			{
+				if (stateCount == States)
+					throw std::length_error("pattern: too many states");
+				sets[stateCount++] = target;
+			}
+			dfa.table[state * Classes + c] = static_cast<std::uint16_t>(index);
+		}
+	}
+	return dfa;
+}
+
+} // end of namespace validators
+
+} // end of namespace
+
+#endif